@@ -0,0 +1,193 @@
+#include "backtest.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <string.h>
+
+typedef struct {
+	Segment* segments;
+	int numSegments;
+	TraversalStore* traversals;
+	ModelParams* params;
+	FeatureIndex index;   // Features grouped by segment, shared by every fold
+
+	RouteRun* runs;       // Sorted by day
+	int* dayOffsets;      // runs range of fold d is [dayOffsets[d], dayOffsets[d + 1])
+	int* dayStatus;       // Result of backtestDay for each fold
+} BacktestContext;
+
+// Split the traversal history into drives. A run continues while traversals stay on the same day,
+// move forward in time and visit the next segment of the route. Only runs that reach the last
+// segment are kept, so each one can be compared against a prediction from its first segment onwards.
+int findRouteRuns(TraversalFeatures* features, int traversalCount, int numSegments, RouteRun* runs, int* skippedRuns) {
+	int runCount = 0;
+	*skippedRuns = 0;
+
+	int i = 0;
+	while (i < traversalCount) {
+		if (features[i].segmentIndex < 0) {
+			i++;
+			continue;
+		}
+
+		int first = i;
+		double observed = features[i].duration;
+		while (i + 1 < traversalCount &&
+			features[i + 1].dayIndex == features[i].dayIndex &&
+			features[i + 1].segmentIndex == features[i].segmentIndex + 1 &&
+			features[i + 1].startTime >= features[i].startTime) {
+			i++;
+			observed += features[i].duration;
+		}
+
+		if (features[i].segmentIndex == numSegments - 1) {
+			RouteRun* run = &runs[runCount++];
+			run->firstTraversal = first;
+			run->startSegment = features[first].segmentIndex;
+			run->startTime = features[first].startTime;
+			run->dow = features[first].dow;
+			run->dayIndex = features[first].dayIndex;
+			run->observed = observed;
+			run->predicted = 0.0;
+			run->predictedStddev = 0.0;
+		}
+		else {
+			(*skippedRuns)++;
+		}
+		i++;
+	}
+	return runCount;
+}
+
+// One fold: predict every run of one day with the shared prediction path, leaving that day's
+// traversals out. Returns 0 on success, -1 if the thread's scratch buffers could not be allocated.
+static int backtestDay(BacktestContext* ctx, int day) {
+	for (int r = ctx->dayOffsets[day]; r < ctx->dayOffsets[day + 1]; r++) {
+		RouteRun* run = &ctx->runs[r];
+		ValidTraversal* first = traversalAt(ctx->traversals, run->firstTraversal);
+		if (predictRouteDuration(ctx->segments, run->startSegment, ctx->numSegments, ctx->traversals, &ctx->index, run->startTime,
+			first->day, first->month, first->year, run->dow, run->dayIndex, &run->predicted, &run->predictedStddev, ctx->params) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static void backtestFold(int day, void* context) {
+	BacktestContext* ctx = (BacktestContext*)context;
+	ctx->dayStatus[day] = backtestDay(ctx, day);
+}
+
+// Order runs by day, then by position in the history so runs of one day keep their order
+static int compareRunsByDay(const void* a, const void* b) {
+	const RouteRun* ra = (const RouteRun*)a;
+	const RouteRun* rb = (const RouteRun*)b;
+	if (ra->dayIndex != rb->dayIndex) return (ra->dayIndex > rb->dayIndex) - (ra->dayIndex < rb->dayIndex);
+	return (ra->firstTraversal > rb->firstTraversal) - (ra->firstTraversal < rb->firstTraversal);
+}
+
+// Leave-one-day-out backtest: for each day with complete runs, the model is built from the other
+// days only and every run of that day is predicted from its first segment. Folds run in parallel.
+// Per-run results are written to report if it is not NULL. Returns 0 on success, -1 on failure.
+int runBacktest(Segment* segments, int numSegments, TraversalStore* traversals, ModelParams* params, BacktestSummary* summary, FILE* report) {
+	auto start = std::chrono::steady_clock::now();
+	int traversalCount = traversals->count;
+
+	memset(summary, 0, sizeof(BacktestSummary));
+
+	BacktestContext ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.segments = segments;
+	ctx.numSegments = numSegments;
+	ctx.traversals = traversals;
+	ctx.params = params;
+
+	// Features are computed once and shared by every fold
+	if (buildFeatureIndex(segments, numSegments, traversals, &ctx.index) != 0) return -1;
+
+	int n = (traversalCount > 0) ? traversalCount : 1;
+	ctx.runs = (RouteRun*)malloc(n * sizeof(RouteRun));
+	ctx.dayOffsets = (int*)malloc((n + 1) * sizeof(int));
+	ctx.dayStatus = (int*)malloc(n * sizeof(int));
+
+	if (!ctx.runs || !ctx.dayOffsets || !ctx.dayStatus) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		freeFeatureIndex(&ctx.index);
+		free(ctx.runs);
+		free(ctx.dayOffsets);
+		free(ctx.dayStatus);
+		return -1;
+	}
+
+	// Find runs and group them into one fold per day
+	int runCount = findRouteRuns(ctx.index.features, traversalCount, numSegments, ctx.runs, &summary->skippedRuns);
+	qsort(ctx.runs, runCount, sizeof(RouteRun), compareRunsByDay);
+
+	int dayCount = 0;
+	for (int r = 0; r < runCount; r++) {
+		if (r == 0 || ctx.runs[r].dayIndex != ctx.runs[r - 1].dayIndex) {
+			ctx.dayOffsets[dayCount++] = r;
+		}
+	}
+	ctx.dayOffsets[dayCount] = runCount;
+
+	parallelFor(dayCount, backtestFold, &ctx);
+
+	// Aggregate error and calibration statistics over the folds that completed
+	int calibrated = 0;
+	for (int d = 0; d < dayCount; d++) {
+		if (ctx.dayStatus[d] != 0) {
+			summary->failedDays++;
+			continue;
+		}
+		summary->days++;
+
+		for (int r = ctx.dayOffsets[d]; r < ctx.dayOffsets[d + 1]; r++) {
+			RouteRun* run = &ctx.runs[r];
+			double error = run->predicted - run->observed;
+
+			summary->runs++;
+			summary->mae += fabs(error);
+			summary->bias += error;
+			summary->rmse += error * error;
+
+			if (run->predictedStddev > 0.0) {
+				double z = error / run->predictedStddev;
+				summary->zRms += z * z;
+				if (fabs(z) <= 1.0) summary->within1Sigma += 1.0;
+				if (fabs(z) <= 2.0) summary->within2Sigma += 1.0;
+				calibrated++;
+			}
+
+			if (report) {
+				ValidTraversal* first = traversalAt(traversals, run->firstTraversal);
+				fprintf(report, "%04d-%02d-%02d %02d:%02d:%02d from segment %d: observed %.0f s, predicted %.1f s (std dev %.1f s)\n",
+					first->year, first->month, first->day, run->startTime / 3600, (run->startTime % 3600) / 60, run->startTime % 60,
+					segments[run->startSegment].segment_id, run->observed, run->predicted, run->predictedStddev);
+			}
+		}
+	}
+
+	if (summary->failedDays > 0) {
+		fprintf(stderr, "Memory allocation failed in %d of %d backtest days, their runs are left out of the results.\n", summary->failedDays, dayCount);
+	}
+
+	if (summary->runs > 0) {
+		summary->mae /= summary->runs;
+		summary->bias /= summary->runs;
+		summary->rmse = sqrt(summary->rmse / summary->runs);
+	}
+	if (calibrated > 0) {
+		summary->zRms = sqrt(summary->zRms / calibrated);
+		summary->within1Sigma /= calibrated;
+		summary->within2Sigma /= calibrated;
+	}
+
+	freeFeatureIndex(&ctx.index);
+	free(ctx.runs);
+	free(ctx.dayOffsets);
+	free(ctx.dayStatus);
+
+	summary->elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef BACKTEST_H
+#define BACKTEST_H
+
+#include <stdio.h>
+
+#include "esp_data.h"
+#include "prediction.h"
+
+// One observed drive: consecutive traversals on the same day covering every segment from
+// startSegment through to the last segment of the route
+typedef struct {
+	int firstTraversal;  // Index of the run's first traversal in the traversal array
+	int startSegment;    // Index into the segments array of the first segment driven
+	int startTime;
+	int dow;
+	int dayIndex;
+	double observed;     // Sum of observed segment durations
+	double predicted;    // Predicted mean from the model built without this run's day
+	double predictedStddev;
+} RouteRun;
+
+typedef struct {
+	int days;            // Days with at least one complete run (one fold per day)
+	int failedDays;      // Folds that could not be predicted (scratch allocation failed), left out of the results
+	int runs;            // Runs predicted
+	int skippedRuns;     // Partial runs that do not reach the end of the route
+	double mae;          // Mean absolute error in seconds
+	double bias;         // Mean of predicted - observed in seconds
+	double rmse;
+	double zRms;         // RMS of (observed - predicted) / stddev, close to 1 when the stddev is calibrated
+	double within1Sigma; // Fraction of runs within one predicted stddev (68% expected)
+	double within2Sigma; // Fraction of runs within two predicted stddevs (95% expected)
+	double elapsedMs;
+} BacktestSummary;
+
+int findRouteRuns(TraversalFeatures* features, int traversalCount, int numSegments, RouteRun* runs, int* skippedRuns);
+int runBacktest(Segment* segments, int numSegments, TraversalStore* traversals, ModelParams* params, BacktestSummary* summary, FILE* report);
+
+#endif // backtest_h
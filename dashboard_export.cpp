@@ -0,0 +1,119 @@
+#include "dashboard_export.h"
+#include "quantile_sketch.h"
+
+#include <chrono>
+#include <math.h>
+
+// Summarize every traversal into per segment x hour-of-week duration digests and reduce them to
+// count/p50/p90 cells. One pass over the store; the result has a fixed size. Returns -1 on failure.
+int buildSegmentHeatmap(Segment* segments, int numSegments, TraversalStore* traversals, SegmentHeatmap* heatmap) {
+	auto start = std::chrono::steady_clock::now();
+
+	heatmap->numSegments = (numSegments < NUM_SEGMENTS) ? numSegments : NUM_SEGMENTS;
+	heatmap->traversals = 0;
+
+	QuantileDigest* digests = (QuantileDigest*)malloc(heatmap->numSegments * HOURS_PER_WEEK * sizeof(QuantileDigest));
+	if (digests == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		return -1;
+	}
+	for (int i = 0; i < heatmap->numSegments * HOURS_PER_WEEK; i++) {
+		initDigest(&digests[i]);
+	}
+	for (int i = 0; i < heatmap->numSegments; i++) {
+		heatmap->segmentIds[i] = segments[i].segment_id;
+	}
+
+	for (int i = 0; i < traversals->count; i++) {
+		ValidTraversal* t = traversalAt(traversals, i);
+
+		int segmentIndex = -1;
+		for (int s = 0; s < heatmap->numSegments; s++) {
+			if (heatmap->segmentIds[s] == t->segment_id) {
+				segmentIndex = s;
+				break;
+			}
+		}
+		if (segmentIndex < 0) continue;
+
+		int hourOfWeek = getDayOfWeek(t) * 24 + (t->startTime / 3600) % 24;
+		digestAdd(&digests[segmentIndex * HOURS_PER_WEEK + hourOfWeek], (double)t->duration, 1.0);
+		heatmap->traversals++;
+	}
+
+	for (int s = 0; s < heatmap->numSegments; s++) {
+		for (int h = 0; h < HOURS_PER_WEEK; h++) {
+			QuantileDigest* digest = &digests[s * HOURS_PER_WEEK + h];
+			HeatmapCell* cell = &heatmap->cells[s][h];
+
+			cell->count = (int)digest->totalWeight;
+			cell->p50 = (cell->count > 0) ? digestQuantile(digest, 0.50) : -1.0;
+			cell->p90 = (cell->count > 0) ? digestQuantile(digest, 0.90) : -1.0;
+		}
+	}
+
+	free(digests);
+	heatmap->elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return 0;
+}
+
+// CSV with a header row and one row per cell, empty cells included so the table always has
+// numSegments x HOURS_PER_WEEK rows. Quantiles of empty cells are left blank.
+int writeSegmentHeatmap(SegmentHeatmap* heatmap, const char* filename) {
+	FILE* file = fopen(filename, "w");
+	if (file == NULL) {
+		perror("Error opening heatmap file");
+		return -1;
+	}
+
+	fprintf(file, "segment_id,hour_of_week,count,p50,p90\n");
+	for (int s = 0; s < heatmap->numSegments; s++) {
+		for (int h = 0; h < HOURS_PER_WEEK; h++) {
+			HeatmapCell* cell = &heatmap->cells[s][h];
+			if (cell->count > 0) {
+				fprintf(file, "%d,%d,%d,%.1f,%.1f\n", heatmap->segmentIds[s], h, cell->count, cell->p50, cell->p90);
+			}
+			else {
+				fprintf(file, "%d,%d,0,,\n", heatmap->segmentIds[s], h);
+			}
+		}
+	}
+
+	fclose(file);
+	return 0;
+}
+
+// Corridor centrelines as a CSV polyline (segment_id,lat,lon), dropping vertices closer than
+// ROUTE_EXPORT_SPACING to the previous one kept. Each corridor keeps its end vertices, so the
+// segments still join up. Returns the number of vertices written, or -1 on failure.
+int writeRoutePolyline(Corridor* corridors, int numCorridors, const char* filename) {
+	FILE* file = fopen(filename, "w");
+	if (file == NULL) {
+		perror("Error opening route polyline file");
+		return -1;
+	}
+
+	int written = 0;
+	fprintf(file, "segment_id,lat,lon\n");
+	for (int c = 0; c < numCorridors; c++) {
+		Corridor* corridor = &corridors[c];
+		RoutePoint* last = NULL;
+
+		for (int v = 0; v < corridor->vertexCount; v++) {
+			RoutePoint* vertex = &corridor->vertices[v];
+
+			if (last != NULL && v < corridor->vertexCount - 1) {
+				double dy = (vertex->lat - last->lat) * METRES_PER_DEGREE_LAT;
+				double dx = (vertex->lon - last->lon) * METRES_PER_DEGREE_LON_EQUATOR * cos(vertex->lat * PI / 180.0);
+				if (dx * dx + dy * dy < ROUTE_EXPORT_SPACING * ROUTE_EXPORT_SPACING) continue;
+			}
+
+			fprintf(file, "%d,%.6f,%.6f\n", corridor->segment_id, vertex->lat, vertex->lon);
+			last = vertex;
+			written++;
+		}
+	}
+
+	fclose(file);
+	return written;
+}
@@ -0,0 +1,31 @@
+#ifndef DASHBOARD_EXPORT_H
+#define DASHBOARD_EXPORT_H
+
+#include "esp_data.h"
+#include "prediction.h"
+#include "route_corridors.h"
+
+#define HOURS_PER_WEEK 168
+#define ROUTE_EXPORT_SPACING 20.0 // Minimum spacing in metres between exported route vertices
+
+// Per segment and hour-of-week duration summary, the cell layout of the heatmap export
+typedef struct {
+	int count;
+	double p50;
+	double p90;
+} HeatmapCell;
+
+// Fixed-size table (segments x HOURS_PER_WEEK, hour 0 = Sunday 00:00), independent of history length
+typedef struct {
+	int segmentIds[NUM_SEGMENTS];
+	int numSegments;
+	HeatmapCell cells[NUM_SEGMENTS][HOURS_PER_WEEK];
+	int traversals;    // Traversals summarized
+	double elapsedMs;
+} SegmentHeatmap;
+
+int buildSegmentHeatmap(Segment* segments, int numSegments, TraversalStore* traversals, SegmentHeatmap* heatmap);
+int writeSegmentHeatmap(SegmentHeatmap* heatmap, const char* filename);
+int writeRoutePolyline(Corridor* corridors, int numCorridors, const char* filename);
+
+#endif // dashboard_export_h
@@ -0,0 +1,152 @@
+#include "departure_planner.h"
+
+// Inverse of the standard normal CDF (Acklam's rational approximation, relative error < 1.2e-9)
+double normalQuantile(double p) {
+	static const double a[] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+	static const double b[] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01 };
+	static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+	static const double d[] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00, 3.754408661907416e+00 };
+	const double pLow = 0.02425;
+
+	if (p <= 0.0) return -HUGE_VAL;
+	if (p >= 1.0) return HUGE_VAL;
+
+	if (p < pLow) {
+		double q = sqrt(-2.0 * log(p));
+		return (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+	}
+	if (p > 1.0 - pLow) {
+		double q = sqrt(-2.0 * log(1.0 - p));
+		return -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+	}
+	double q = p - 0.5;
+	double r = q * q;
+	return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+}
+
+typedef struct {
+	Segment* segments;
+	TraversalStore* traversals;
+	int targetArrival;
+	double z;
+	int targetYear;
+	int targetMonth;
+	int targetDay;
+	int targetDOW;
+	ModelParams* params;
+	int evaluations;
+} PlannerQuery;
+
+// Evaluate one departure minute; returns 1 if the arrival at the requested confidence is on time
+static int isSafeDeparture(PlannerQuery* query, int minute, double* routeMean, double* routeStddev, double* safeArrival) {
+	predictOverallDuration(query->segments, query->traversals, minute * 60, query->targetDay, query->targetMonth, query->targetYear, query->targetDOW, routeMean, routeStddev, query->params);
+	query->evaluations++;
+
+	*safeArrival = minute * 60 + *routeMean + query->z * *routeStddev;
+	return *safeArrival <= query->targetArrival;
+}
+
+// Find the latest departure (to the minute, same day) that arrives by targetArrival with the given
+// confidence, assuming normally distributed route durations. Arrival time is assumed to be
+// non-decreasing in departure time, so instead of scanning every minute the search:
+//   1. evaluates the target itself and jumps back by the predicted duration at that time,
+//   2. walks in PLANNER_COARSE_STEP steps from there until safe/unsafe departures bracket the answer,
+//   3. bisects the bracket down to one minute.
+// Returns 0 on success (result->found says whether a safe departure exists), -1 on bad input.
+int findLatestDeparture(Segment* segments, TraversalStore* traversals, int targetArrival, double confidence, int targetYear, int targetMonth, int targetDay, int targetDOW, ModelParams* params, DepartureResult* result) {
+	if (confidence <= 0.0 || confidence >= 1.0 || targetArrival < 0 || targetArrival >= 86400) {
+		printf("Invalid departure search parameters.\n");
+		return -1;
+	}
+
+	PlannerQuery query = { segments, traversals, targetArrival, normalQuantile(confidence), targetYear, targetMonth, targetDay, targetDOW, params, 0 };
+
+	int earliest = (targetArrival - PLANNER_SEARCH_WINDOW + 59) / 60; // Candidate range in minutes
+	if (earliest < 0) earliest = 0;
+	int latest = targetArrival / 60;
+	int step = PLANNER_COARSE_STEP / 60;
+
+	double mean, stddev, arrival;
+	double bestMean = 0.0, bestStddev = 0.0, bestArrival = 0.0;
+	int lo, hi; // lo is known safe, hi is known unsafe
+
+	result->found = 0;
+	result->departureTime = 0;
+	result->candidates = latest - earliest + 1;
+
+	// 1. Leaving at the target itself, and a first guess one predicted duration earlier
+	if (isSafeDeparture(&query, latest, &mean, &stddev, &arrival)) {
+		lo = hi = latest; // Degenerate, the route takes no time
+		bestMean = mean;
+		bestStddev = stddev;
+		bestArrival = arrival;
+	}
+	else {
+		hi = latest;
+		int guess = (int)floor((targetArrival - (arrival - latest * 60)) / 60.0);
+		if (guess > latest - 1) guess = latest - 1;
+		if (guess < earliest) guess = earliest;
+
+		// 2. Walk in coarse steps until a safe and an unsafe departure bracket the answer
+		if (isSafeDeparture(&query, guess, &mean, &stddev, &arrival)) {
+			lo = guess;
+			bestMean = mean;
+			bestStddev = stddev;
+			bestArrival = arrival;
+
+			while (lo + step < hi) {
+				if (isSafeDeparture(&query, lo + step, &mean, &stddev, &arrival)) {
+					lo += step;
+					bestMean = mean;
+					bestStddev = stddev;
+					bestArrival = arrival;
+				}
+				else {
+					hi = lo + step;
+					break;
+				}
+			}
+		}
+		else {
+			hi = guess;
+			lo = -1;
+			while (hi > earliest) {
+				int candidate = (hi - step > earliest) ? hi - step : earliest;
+				if (isSafeDeparture(&query, candidate, &mean, &stddev, &arrival)) {
+					lo = candidate;
+					bestMean = mean;
+					bestStddev = stddev;
+					bestArrival = arrival;
+					break;
+				}
+				hi = candidate;
+			}
+			if (lo < 0) {
+				result->evaluations = query.evaluations;
+				return 0; // Even the earliest departure in the window is too late
+			}
+		}
+
+		// 3. Bisect down to one minute
+		while (hi - lo > 1) {
+			int mid = lo + (hi - lo) / 2;
+			if (isSafeDeparture(&query, mid, &mean, &stddev, &arrival)) {
+				lo = mid;
+				bestMean = mean;
+				bestStddev = stddev;
+				bestArrival = arrival;
+			}
+			else {
+				hi = mid;
+			}
+		}
+	}
+
+	result->found = 1;
+	result->departureTime = lo * 60;
+	result->routeMean = bestMean;
+	result->routeStddev = bestStddev;
+	result->safeArrival = bestArrival;
+	result->evaluations = query.evaluations;
+	return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef DEPARTURE_PLANNER_H
+#define DEPARTURE_PLANNER_H
+
+#include "esp_data.h"
+#include "prediction.h"
+
+#define PLANNER_SEARCH_WINDOW 14400 // Latest departure is searched up to 4 hours before the target arrival
+#define PLANNER_COARSE_STEP 900     // Coarse search step (15 minutes), refined to the minute by bisection
+
+typedef struct {
+	int found;            // 1 if a safe departure exists within the search window
+	int departureTime;    // Latest safe departure, seconds after midnight (minute resolution)
+	double routeMean;     // Predicted route duration for that departure
+	double routeStddev;
+	double safeArrival;   // Arrival time at the requested confidence, seconds after midnight
+	int evaluations;      // Number of predictOverallDuration calls used by the search
+	int candidates;       // Number of candidate minutes a brute-force scan would evaluate
+} DepartureResult;
+
+double normalQuantile(double p);
+int findLatestDeparture(Segment* segments, TraversalStore* traversals, int targetArrival, double confidence, int targetYear, int targetMonth, int targetDay, int targetDOW, ModelParams* params, DepartureResult* result);
+
+#endif // departure_planner_h
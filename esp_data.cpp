@@ -2,11 +2,25 @@
 
 #include "esp_data.h"
 
+#include <limits.h>
 #include <math.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+static int verboseOutput = 1; // Per-point and per-traversal log lines
+
+// Turn the per-point and per-traversal log lines on or off (on by default). Timed runs turn them off
+// so console output does not dominate the measurement.
+void setESPDataVerbose(int verbose) {
+	verboseOutput = verbose;
+}
+
+// Whether the log lines are on, for other segmentation passes that log the same way
+int getESPDataVerbose() {
+	return verboseOutput;
+}
+
 int getESPData(FILE *filepointer, ESPDataPoint* data) {
 
 	// Counter for number of ESP data points read
@@ -18,7 +32,7 @@ int getESPData(FILE *filepointer, ESPDataPoint* data) {
 		return -1;
 	}
 	else {
-		printf("Reading ESP data...\n");
+		if (verboseOutput) printf("Reading ESP data...\n");
 
 		ESPDataPoint* ESPData = data; // Pointer to the ESPData array
 
@@ -51,13 +65,13 @@ int getESPData(FILE *filepointer, ESPDataPoint* data) {
 
 			// Check if the line was parsed correctly by confirming the number of items read
 			if (n != 7) {
-				printf("Error parsing ESP data line: %s\n", buffer);
+				if (verboseOutput) printf("Error parsing ESP data line: %s\n", buffer);
 				continue; // Skip malformed lines
 			}
 
 			// Confirm validity of parsed data
 			if (strcmp(latStr, "INVALID_LAT") == 0 || strcmp(lonStr, "INVALID_LNG") == 0 || strcmp(yearStr, "INVALID_DATE") == 0 || strcmp(timeStr, "INVALID_TIME") == 0) {
-				printf("Skipping invalid ESP data point: %s\n", buffer);
+				if (verboseOutput) printf("Skipping invalid ESP data point: %s\n", buffer);
 				continue; // Skip invalid data points
 			}
 
@@ -72,32 +86,33 @@ int getESPData(FILE *filepointer, ESPDataPoint* data) {
 			// Convert time string to individual components
 			sscanf(timeStr, "%d:%d:%d", &tempHour, &tempMinute, &tempSecond);
 
-			tempHour -= TIME_OFFSET;               // Convert from UTC to local time
-			if (tempHour < 0) tempHour += 24;      // Wrap around midnight
-			int totalSeconds = tempHour * 3600 + tempMinute * 60 + tempSecond;
-
-			// Store the converted data in the ESPData array
-			ESPData[count].lat = tempLat;
-			ESPData[count].lon = tempLon;
-			ESPData[count].speed = tempSpeed;
-			ESPData[count].year = tempYear;
-			ESPData[count].month = tempMonth;
-			ESPData[count].day = tempDay;
-			ESPData[count].time = totalSeconds; // Convert time to seconds
+			// Clamp speed to the fixed-point range
+			double scaledSpeed = tempSpeed * SPEED_SCALE;
+			if (scaledSpeed > SHRT_MAX) scaledSpeed = SHRT_MAX;
+			if (scaledSpeed < 0) scaledSpeed = 0;
+
+			// Store the converted data in the ESPData array. The GPS reports UTC, local time is derived when needed
+			ESPData[count].timestamp = daysFromCivil(tempYear, tempMonth, tempDay) * 86400 + tempHour * 3600 + tempMinute * 60 + tempSecond;
+			ESPData[count].lat = (int)llround(tempLat * COORD_SCALE);
+			ESPData[count].lon = (int)llround(tempLon * COORD_SCALE);
+			ESPData[count].speed = (short)lround(scaledSpeed);
 			count++;
 
-			// Print the read data point for verification
+			// Print the read data point for verification, in local time
+			if (!verboseOutput) continue;
+			int localYear, localMonth, localDay, localSeconds;
+			pointLocalTime(&ESPData[count - 1], &localYear, &localMonth, &localDay, &localSeconds);
 			printf("Read ESP data point %d: Lat: %f, Lon: %f, Speed: %f, Date: %04d-%02d-%02d, Time: %02d:%02d:%02d\n",
 				count,
-				ESPData[count - 1].lat,
-				ESPData[count - 1].lon,
-				ESPData[count - 1].speed,
-				ESPData[count - 1].year,
-				ESPData[count - 1].month,
-				ESPData[count - 1].day,
-				tempHour,
-				tempMinute,
-				tempSecond
+				(double)ESPData[count - 1].lat / COORD_SCALE,
+				(double)ESPData[count - 1].lon / COORD_SCALE,
+				(double)ESPData[count - 1].speed / SPEED_SCALE,
+				localYear,
+				localMonth,
+				localDay,
+				localSeconds / 3600,
+				(localSeconds % 3600) / 60,
+				localSeconds % 60
 			);
 		}
 
@@ -107,38 +122,31 @@ int getESPData(FILE *filepointer, ESPDataPoint* data) {
 	return count; // Indicate successful reading
 }
 
-int processPoint(ESPDataPoint* data, int startIndex, Segment* segments, int numSegments,
-	int numPoints, ValidTraversal* traversals, int* traversalCount) {
+// Fixed-point bounding box test, bounds inclusive
+static inline int pointInSegment(ESPDataPoint* point, SegmentBounds* bounds) {
+	return point->lat <= bounds->maxLat && point->lat >= bounds->minLat &&
+		point->lon <= bounds->maxLon && point->lon >= bounds->minLon;
+}
+
+int processPoint(ESPDataPoint* data, int startIndex, Segment* segments, SegmentBounds* bounds, int numSegments,
+	int numPoints, TraversalStore* traversals) {
 
 	for (int j = 0; j < numSegments; j++) {
 		// Check if this point is inside the segment
-		if (data[startIndex].lat <= segments[j].max_lat && data[startIndex].lat >= segments[j].min_lat &&
-			data[startIndex].lon <= segments[j].max_lon && data[startIndex].lon >= segments[j].min_lon) {
+		if (pointInSegment(&data[startIndex], &bounds[j])) {
 
 			// Check if previous point was outside bounding zone
-			if (startIndex == 0 ||
-				!(data[startIndex - 1].lat <= segments[j].max_lat && data[startIndex - 1].lat >= segments[j].min_lat &&
-					data[startIndex - 1].lon <= segments[j].max_lon && data[startIndex - 1].lon >= segments[j].min_lon)) {
+			if (startIndex == 0 || !pointInSegment(&data[startIndex - 1], &bounds[j])) {
 
-				double duration = traversalTime(data, startIndex, &segments[j], numPoints);
+				// Duration, speed statistics and exit index all come from one pass over the traversal's points
+				SpeedStats speed;
+				int endIndex;
+				double duration = traversalTime(data, startIndex, &bounds[j], numPoints, &speed, &endIndex);
 				if (duration < 0) return startIndex;  // invalid traversal
 
-				int result = recordTraversal(traversals, traversalCount, &segments[j], duration, &data[startIndex]);
+				int result = recordTraversal(traversals, segments[j].segment_id, duration, &data[startIndex], &speed);
 				if (result == 0) {
-					// Find the index where traversal ended
-					int endIndex = startIndex;
-					while (endIndex + 1 < numPoints &&
-						data[endIndex].lat <= segments[j].max_lat && data[endIndex].lat >= segments[j].min_lat &&
-						data[endIndex].lon <= segments[j].max_lon && data[endIndex].lon >= segments[j].min_lon) {
-
-						endIndex++;
-
-						// Break if stuck near the end of the dataset
-						if (endIndex >= numPoints - 1)
-							break;
-					}
-
-					printf("Exited segment %d at index %d (duration: %.1f sec)\n", segments[j].segment_id, endIndex, duration);
+					if (verboseOutput) printf("Exited segment %d at index %d (duration: %.1f sec)\n", segments[j].segment_id, endIndex, duration);
 					return endIndex;  // return index after exiting segment
 				}
 			}
@@ -149,40 +157,191 @@ int processPoint(ESPDataPoint* data, int startIndex, Segment* segments, int numS
 	return (startIndex + 1 < numPoints) ? startIndex + 1 : numPoints;
 }
 
-double traversalTime(ESPDataPoint* data, int startIndex, Segment* segment, int numPoints) {
+// Duration of the traversal starting at startIndex. Also accumulates its speed statistics and
+// sets endIndex to the first point after it.
+double traversalTime(ESPDataPoint* data, int startIndex, SegmentBounds* bounds, int numPoints, SpeedStats* speed, int* endIndex) {
 	int i = startIndex;
-	int startTime = data[startIndex].time;
+	long long startTime = data[startIndex].timestamp;
 
-	while(i < numPoints && 
-		data[i].lat <= segment->max_lat && data[i].lat >= segment->min_lat &&
-		data[i].lon <= segment->max_lon && data[i].lon >= segment->min_lon) {
+	beginSpeedStats(speed, &data[startIndex]);
+	while(i < numPoints && pointInSegment(&data[i], bounds)) {
+			if (i > startIndex) addSpeedInterval(speed, &data[i - 1], &data[i]);
 			i++;
 	}
 
 	if(i >= numPoints) {
 		return -1; // Invalid traversal if data ends before exiting segment
 	}
+	*endIndex = i;
 
-	double duration = data[i - 1].time - startTime;
+	double duration = (double)(data[i - 1].timestamp - startTime); // Epoch timestamps stay correct across midnight
 	if(duration < 10 || duration > MAX_TRAVERSAL_DURATION) {
 		return -1; // Invalid traversal if duration is negative or exceeds maximum allowed
 	}
 	return duration;
 }
 
-int recordTraversal (ValidTraversal* traversals, int* traversalCount, Segment* segment, double duration, ESPDataPoint* dataPoint) {
-	if(*traversalCount >= MAX_TRAVERSALS) {
-		printf("Maximum number of traversals reached. Cannot record more traversals.\n");
+int recordTraversal (TraversalStore* traversals, int segment_id, double duration, ESPDataPoint* dataPoint, SpeedStats* speed) {
+	ValidTraversal* vt = appendTraversal(traversals);
+	if(vt == NULL) {
+		printf("Memory allocation failed. Cannot record more traversals.\n");
 		return -1;
 	}
-	ValidTraversal* vt = &traversals[*traversalCount];
-	vt->segment_id = segment->segment_id;
+	vt->segment_id = segment_id;
 	vt->duration = (int)duration;
-	vt->year = dataPoint->year;
-	vt->month = dataPoint->month;
-	vt->day = dataPoint->day;
-	vt->startTime = dataPoint->time;
-	(*traversalCount)++;
+	pointLocalTime(dataPoint, &vt->year, &vt->month, &vt->day, &vt->startTime);
+
+	// Speed features go to the columns alongside the traversal (appendTraversal marks them unknown)
+	if (speed != NULL && speed->seconds > 0) {
+		int index = traversals->count - 1;
+		SpeedColumns* columns = speedColumnsAt(traversals, index);
+		int row = traversalRow(index);
+		columns->meanSpeed[row] = (float)((double)speed->speedSeconds / speed->seconds / SPEED_SCALE);
+		columns->minSpeed[row] = (float)speed->minSpeed / SPEED_SCALE;
+		columns->slowSeconds[row] = (short)speed->slowSeconds;
+		columns->stopCount[row] = (short)speed->stopCount;
+	}
 	return 0; // Successful recording
 
 }
+
+// Update the minimum speed and stop state for a point. A stop starts when the speed drops below
+// STOP_SPEED_THRESHOLD and lasts until it climbs back above SLOW_SPEED_THRESHOLD, so GPS speed
+// jitter around walking pace is not counted as many stops.
+static void updateStopState(SpeedStats* speed, ESPDataPoint* point) {
+	if (point->speed < speed->minSpeed) speed->minSpeed = point->speed;
+
+	if (!speed->stopped && point->speed < STOP_SPEED_THRESHOLD * SPEED_SCALE) {
+		speed->stopped = 1;
+		speed->stopCount++;
+	}
+	else if (speed->stopped && point->speed > SLOW_SPEED_THRESHOLD * SPEED_SCALE) {
+		speed->stopped = 0;
+	}
+}
+
+// Start the statistics of a traversal at its first point
+void beginSpeedStats(SpeedStats* speed, ESPDataPoint* first) {
+	speed->speedSeconds = 0;
+	speed->seconds = 0;
+	speed->slowSeconds = 0;
+	speed->minSpeed = first->speed;
+	speed->stopCount = 0;
+	speed->stopped = 0;
+	updateStopState(speed, first);
+}
+
+// Add the interval between two consecutive points of a traversal. The speed at the start of the
+// interval is held over it, so the statistics stay time-weighted when samples are missed.
+void addSpeedInterval(SpeedStats* speed, ESPDataPoint* from, ESPDataPoint* to) {
+	int seconds = (int)(to->timestamp - from->timestamp);
+	speed->speedSeconds += (long long)from->speed * seconds;
+	speed->seconds += seconds;
+	if (from->speed < SLOW_SPEED_THRESHOLD * SPEED_SCALE) speed->slowSeconds += seconds;
+	updateStopState(speed, to);
+}
+
+// Convert the floating-point segment bounds to the fixed-point units of ESPDataPoint
+void initSegmentBounds(Segment* segments, int numSegments, SegmentBounds* bounds) {
+	for (int i = 0; i < numSegments; i++) {
+		bounds[i].minLat = (int)llround(segments[i].min_lat * COORD_SCALE);
+		bounds[i].minLon = (int)llround(segments[i].min_lon * COORD_SCALE);
+		bounds[i].maxLat = (int)llround(segments[i].max_lat * COORD_SCALE);
+		bounds[i].maxLon = (int)llround(segments[i].max_lon * COORD_SCALE);
+	}
+}
+
+// Local calendar date and seconds after local midnight of a point, using TIME_OFFSET
+void pointLocalTime(ESPDataPoint* point, int* year, int* month, int* day, int* secondOfDay) {
+	long long local = point->timestamp - TIME_OFFSET * 3600;
+	long long days = local / 86400;
+	long long seconds = local % 86400;
+	if (seconds < 0) {
+		seconds += 86400;
+		days--;
+	}
+	civilFromDays(days, year, month, day);
+	*secondOfDay = (int)seconds;
+}
+
+static int nextStoreGeneration = 0; // Stores are created and reloaded on the main thread only
+
+void initTraversalStore(TraversalStore* store) {
+	store->generation = ++nextStoreGeneration;
+	store->chunks = NULL;
+	store->speedChunks = NULL;
+	store->chunkCount = 0;
+	store->chunkCapacity = 0;
+	store->count = 0;
+}
+
+void freeTraversalStore(TraversalStore* store) {
+	for (int c = 0; c < store->chunkCount; c++) {
+		free(store->chunks[c]);
+		free(store->speedChunks[c]);
+	}
+	free(store->chunks);
+	free(store->speedChunks);
+	initTraversalStore(store);
+}
+
+// Reserve the next traversal slot, adding a chunk when the last one is full. The slot's speed
+// features start out unknown. Returns NULL if memory runs out; the store is left unchanged in that case.
+ValidTraversal* appendTraversal(TraversalStore* store) {
+	if (store->count == store->chunkCount * TRAVERSAL_CHUNK_SIZE) {
+		if (store->chunkCount == store->chunkCapacity) {
+			int capacity = (store->chunkCapacity > 0) ? store->chunkCapacity * 2 : 16;
+			ValidTraversal** chunks = (ValidTraversal**)realloc(store->chunks, capacity * sizeof(ValidTraversal*));
+			if (chunks == NULL) return NULL;
+			store->chunks = chunks;
+			SpeedColumns** speedChunks = (SpeedColumns**)realloc(store->speedChunks, capacity * sizeof(SpeedColumns*));
+			if (speedChunks == NULL) return NULL;
+			store->speedChunks = speedChunks;
+			store->chunkCapacity = capacity;
+		}
+
+		ValidTraversal* chunk = (ValidTraversal*)malloc(TRAVERSAL_CHUNK_SIZE * sizeof(ValidTraversal));
+		SpeedColumns* speedChunk = (SpeedColumns*)malloc(sizeof(SpeedColumns));
+		if (chunk == NULL || speedChunk == NULL) {
+			free(chunk);
+			free(speedChunk);
+			return NULL;
+		}
+		store->chunks[store->chunkCount] = chunk;
+		store->speedChunks[store->chunkCount] = speedChunk;
+		store->chunkCount++;
+	}
+
+	int index = store->count++;
+	SpeedColumns* columns = speedColumnsAt(store, index);
+	int row = traversalRow(index);
+	columns->meanSpeed[row] = -1.0f;
+	columns->minSpeed[row] = -1.0f;
+	columns->slowSeconds[row] = 0;
+	columns->stopCount[row] = 0;
+	return traversalAt(store, index);
+}
+
+// Number of days since 1970-01-01 for a given calendar date (proleptic Gregorian calendar)
+long long daysFromCivil(int year, int month, int day) {
+	long long y = (month <= 2) ? year - 1 : year;           // Years start in March so the leap day falls at the end
+	long long era = (y >= 0 ? y : y - 399) / 400;
+	long long yearOfEra = y - era * 400;                      // [0, 399]
+	long long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1; // [0, 365]
+	long long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear; // [0, 146096]
+	return era * 146097 + dayOfEra - 719468;
+}
+
+// Inverse of daysFromCivil, converts a day count since 1970-01-01 back to a calendar date
+void civilFromDays(long long days, int* year, int* month, int* day) {
+	days += 719468;
+	long long era = (days >= 0 ? days : days - 146096) / 146097;
+	long long dayOfEra = days - era * 146097;                                              // [0, 146096]
+	long long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365; // [0, 399]
+	long long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);  // [0, 365]
+	long long monthPrime = (5 * dayOfYear + 2) / 153;                                      // [0, 11], March = 0
+
+	*day = (int)(dayOfYear - (153 * monthPrime + 2) / 5 + 1);
+	*month = (int)(monthPrime < 10 ? monthPrime + 3 : monthPrime - 9);
+	*year = (int)(yearOfEra + era * 400 + (*month <= 2));
+}
@@ -5,20 +5,25 @@
 #include <stdio.h>
 
 #define MAX_ESP_DATA_POINTS 100000 // Maximum number of ESP data points, sufficient for > 1 month of data at 1-second invervals
-#define MAX_TRAVERSALS 1000  // Maximum number of valid traversals to store
 #define MAX_TRAVERSAL_DURATION 1800 // Maximum valid traversal duration in seconds (2 hours)
 #define TIME_OFFSET 7 // Time offset in hours for local time adjustment (e.g., UTC-7 for PDT)
+#define COORD_SCALE 10000000 // Lat/lon stored as fixed-point integers of 1e-7 degrees (~1 cm)
+#define SPEED_SCALE 100      // Speed stored as fixed-point integers of 0.01 km/h
+#define SLOW_SPEED_THRESHOLD 10 // km/h, time spent below this counts as congested
+#define STOP_SPEED_THRESHOLD 3  // km/h, dropping below this counts as a stop; the stop ends above SLOW_SPEED_THRESHOLD
 
-// Individual ESP data point structure for each line in the file
+// Individual ESP data point structure for each line in the file. Packed to 20 bytes so the
+// segmentation sweep streams half as much memory as with separate date/time fields and doubles.
+#pragma pack(push, 4)
 typedef struct {
-	double lat;
-	double lon;
-	double speed;
-	int year;
-	int month;
-	int day;
-	int time; // In seconds
+	long long timestamp; // UTC epoch seconds, monotonic across midnight and multi-day logs
+	int lat;             // Degrees * COORD_SCALE
+	int lon;             // Degrees * COORD_SCALE
+	short speed;         // km/h * SPEED_SCALE
 } ESPDataPoint;
+#pragma pack(pop)
+
+static_assert(sizeof(ESPDataPoint) == 20, "ESPDataPoint should pack to 20 bytes");
 
 typedef struct {
 	int segment_id;
@@ -28,6 +33,15 @@ typedef struct {
 	double max_lon;
 } Segment;
 
+// Segment bounding box in the fixed-point COORD_SCALE units of ESPDataPoint, built by
+// initSegmentBounds before a segmentation sweep so points are compared without conversions
+typedef struct {
+	int minLat;
+	int minLon;
+	int maxLat;
+	int maxLon;
+} SegmentBounds;
+
 typedef struct {
 	int segment_id;
 	int duration;
@@ -37,9 +51,70 @@ typedef struct {
 	int startTime;
 } ValidTraversal;
 
+// Running speed statistics of one traversal, accumulated while its points are swept
+typedef struct {
+	long long speedSeconds; // Sum of speed * interval in SPEED_SCALE units
+	int seconds;
+	int slowSeconds;        // Seconds below SLOW_SPEED_THRESHOLD
+	int minSpeed;           // SPEED_SCALE units
+	int stopCount;
+	int stopped;            // Currently in a stop
+} SpeedStats;
+
+#define TRAVERSAL_CHUNK_SHIFT 12
+#define TRAVERSAL_CHUNK_SIZE (1 << TRAVERSAL_CHUNK_SHIFT) // Traversals per chunk (96 KB)
+
+// Speed features of the traversals in one chunk, one column per feature so model stages can scan
+// a feature without touching the others. meanSpeed is negative when a traversal has no speed data
+// (for example when it was loaded from a traversal file).
+typedef struct {
+	float meanSpeed[TRAVERSAL_CHUNK_SIZE];        // km/h, time-weighted
+	float minSpeed[TRAVERSAL_CHUNK_SIZE];         // km/h
+	short slowSeconds[TRAVERSAL_CHUNK_SIZE];      // Seconds below SLOW_SPEED_THRESHOLD
+	short stopCount[TRAVERSAL_CHUNK_SIZE];
+} SpeedColumns;
+
+// Growable traversal storage. Traversals live in fixed-size chunks that are never moved or freed
+// until the store is, so pointers into the store stay valid as it grows; only the small chunk
+// directories are reallocated. Each traversal chunk has a matching chunk of speed feature columns.
+typedef struct {
+	ValidTraversal** chunks;    // Chunk directory
+	SpeedColumns** speedChunks; // Speed feature chunk directory, parallel to chunks
+	int chunkCount;
+	int chunkCapacity;          // Directory slots
+	int count;                  // Traversals stored
+	int generation;             // New value every time the store is initialized or freed, so caches
+	                            // built from an earlier history can tell it was replaced
+} TraversalStore;
+
+// Traversal at index (0 <= index < store->count)
+static inline ValidTraversal* traversalAt(TraversalStore* store, int index) {
+	return &store->chunks[index >> TRAVERSAL_CHUNK_SHIFT][index & (TRAVERSAL_CHUNK_SIZE - 1)];
+}
+
+// Speed columns holding traversal index, at row traversalRow(index)
+static inline SpeedColumns* speedColumnsAt(TraversalStore* store, int index) {
+	return store->speedChunks[index >> TRAVERSAL_CHUNK_SHIFT];
+}
+
+static inline int traversalRow(int index) {
+	return index & (TRAVERSAL_CHUNK_SIZE - 1);
+}
+
 int getESPData(FILE* filepointer, ESPDataPoint* data);
-int processPoint(ESPDataPoint* data, int i, Segment* segments, int numSegments, int numPoints, ValidTraversal* traversals, int* traversalCount);
-double traversalTime(ESPDataPoint* data, int startIndex, Segment* segment, int numPoints);
-int recordTraversal(ValidTraversal* traversals, int* traversalCount, Segment* segment, double duration, ESPDataPoint* dataPoint);
+void setESPDataVerbose(int verbose);
+int getESPDataVerbose();
+void initSegmentBounds(Segment* segments, int numSegments, SegmentBounds* bounds);
+void pointLocalTime(ESPDataPoint* point, int* year, int* month, int* day, int* secondOfDay);
+int processPoint(ESPDataPoint* data, int i, Segment* segments, SegmentBounds* bounds, int numSegments, int numPoints, TraversalStore* traversals);
+double traversalTime(ESPDataPoint* data, int startIndex, SegmentBounds* bounds, int numPoints, SpeedStats* speed, int* endIndex);
+int recordTraversal(TraversalStore* traversals, int segment_id, double duration, ESPDataPoint* dataPoint, SpeedStats* speed);
+void beginSpeedStats(SpeedStats* speed, ESPDataPoint* first);
+void addSpeedInterval(SpeedStats* speed, ESPDataPoint* from, ESPDataPoint* to);
+void initTraversalStore(TraversalStore* store);
+void freeTraversalStore(TraversalStore* store);
+ValidTraversal* appendTraversal(TraversalStore* store);
+long long daysFromCivil(int year, int month, int day);
+void civilFromDays(long long days, int* year, int* month, int* day);
 
 #endif // esp_data_h
@@ -0,0 +1,383 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "gps_archive.h"
+
+#include <limits.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#define ARCHIVE_INDEX_ENTRY_SIZE 32     // Bytes per serialized ArchiveBlockIndex entry
+#define ARCHIVE_MAX_VARINT_BYTES 10     // Worst case LEB128 length of a 64-bit value
+#define ARCHIVE_NUM_COLUMNS 4           // Timestamp, lat, lon, speed
+
+// Points use the archive's fixed-point units, so columns are copied without conversion
+static_assert(COORD_SCALE == ARCHIVE_COORD_SCALE && SPEED_SCALE == ARCHIVE_SPEED_SCALE, "ESPDataPoint units must match the archive format");
+
+// 64-bit file positions, long is only 32 bits on MSVC and archives may exceed 2 GB
+static int archiveSeek(FILE* filepointer, long long offset, int origin) {
+#ifdef _MSC_VER
+	return _fseeki64(filepointer, offset, origin);
+#else
+	return fseeko(filepointer, (off_t)offset, origin);
+#endif
+}
+
+static long long archiveTell(FILE* filepointer) {
+#ifdef _MSC_VER
+	return _ftelli64(filepointer);
+#else
+	return (long long)ftello(filepointer);
+#endif
+}
+
+// Map signed deltas onto unsigned integers so small negative values also encode to short varints
+static uint64_t zigzagEncode(int64_t value) {
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t zigzagDecode(uint64_t value) {
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// Write an unsigned LEB128 varint, returns the number of bytes written
+static int putVarint(uint8_t* buffer, uint64_t value) {
+	int n = 0;
+	while (value >= 0x80) {
+		buffer[n++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	buffer[n++] = (uint8_t)value;
+	return n;
+}
+
+// Read an unsigned LEB128 varint, returns the number of bytes consumed or 0 if the buffer is truncated
+static int getVarint(const uint8_t* buffer, const uint8_t* end, uint64_t* value) {
+	uint64_t result = 0;
+	int shift = 0;
+	int n = 0;
+	while (buffer + n < end && n < ARCHIVE_MAX_VARINT_BYTES) {
+		uint8_t byte = buffer[n++];
+		result |= (uint64_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			*value = result;
+			return n;
+		}
+		shift += 7;
+	}
+	return 0;
+}
+
+// Little-endian fixed width helpers so archives are portable between the PC tools and other hosts
+static void putU32(uint8_t* buffer, uint32_t value) {
+	for (int i = 0; i < 4; i++) buffer[i] = (uint8_t)(value >> (8 * i));
+}
+
+static void putU64(uint8_t* buffer, uint64_t value) {
+	for (int i = 0; i < 8; i++) buffer[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint32_t getU32(const uint8_t* buffer) {
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++) value |= (uint32_t)buffer[i] << (8 * i);
+	return value;
+}
+
+static uint64_t getU64(const uint8_t* buffer) {
+	uint64_t value = 0;
+	for (int i = 0; i < 8; i++) value |= (uint64_t)buffer[i] << (8 * i);
+	return value;
+}
+
+// Encode one column of int64 values as a zigzag varint delta stream, returns bytes written
+static int encodeColumn(uint8_t* buffer, int64_t* values, int count) {
+	int n = 0;
+	int64_t previous = 0;
+	for (int i = 0; i < count; i++) {
+		n += putVarint(buffer + n, zigzagEncode(values[i] - previous));
+		previous = values[i];
+	}
+	return n;
+}
+
+// Decode one column of a block, returns bytes consumed or 0 on a corrupt stream
+static int decodeColumn(const uint8_t* buffer, const uint8_t* end, int64_t* values, int count) {
+	int n = 0;
+	int64_t previous = 0;
+	for (int i = 0; i < count; i++) {
+		uint64_t raw;
+		int used = getVarint(buffer + n, end, &raw);
+		if (used == 0) return 0;
+		n += used;
+		previous += zigzagDecode(raw);
+		values[i] = previous;
+	}
+	return n;
+}
+
+int isGPSArchive(FILE* filepointer) {
+	char magic[4];
+	long long position = archiveTell(filepointer);
+
+	int matched = fread(magic, 1, sizeof(magic), filepointer) == sizeof(magic) && memcmp(magic, ARCHIVE_MAGIC, sizeof(magic)) == 0;
+	archiveSeek(filepointer, position, SEEK_SET); // Leave the stream where the caller had it
+	return matched;
+}
+
+// Writes the points as a columnar archive: header, compressed blocks, then the block index.
+// Returns the number of blocks written, or -1 on failure. The file must be opened in binary mode.
+int writeGPSArchive(FILE* filepointer, ESPDataPoint* data, int numPoints) {
+	if (filepointer == NULL) {
+		printf("Error opening archive file.\n");
+		return -1;
+	}
+
+	int blockCount = (numPoints + ARCHIVE_BLOCK_POINTS - 1) / ARCHIVE_BLOCK_POINTS;
+
+	ArchiveBlockIndex* index = (ArchiveBlockIndex*)malloc((blockCount > 0 ? blockCount : 1) * sizeof(ArchiveBlockIndex));
+	uint8_t* buffer = (uint8_t*)malloc(ARCHIVE_BLOCK_POINTS * ARCHIVE_NUM_COLUMNS * ARCHIVE_MAX_VARINT_BYTES);
+	int64_t* column = (int64_t*)malloc(ARCHIVE_BLOCK_POINTS * sizeof(int64_t));
+
+	if (!index || !buffer || !column) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		free(index);
+		free(buffer);
+		free(column);
+		return -1;
+	}
+
+	// Reserve space for the header, it is filled in once the index offset is known
+	uint8_t header[ARCHIVE_HEADER_SIZE] = { 0 };
+	fwrite(header, 1, sizeof(header), filepointer);
+
+	for (int b = 0; b < blockCount; b++) {
+		ESPDataPoint* block = data + b * ARCHIVE_BLOCK_POINTS;
+		int count = numPoints - b * ARCHIVE_BLOCK_POINTS;
+		if (count > ARCHIVE_BLOCK_POINTS) count = ARCHIVE_BLOCK_POINTS;
+
+		int length = 0;
+
+		// Timestamp column, also tracks the block's time range for the index
+		index[b].minTimestamp = block[0].timestamp;
+		index[b].maxTimestamp = index[b].minTimestamp;
+		for (int i = 0; i < count; i++) {
+			column[i] = block[i].timestamp;
+			if (column[i] < index[b].minTimestamp) index[b].minTimestamp = column[i];
+			if (column[i] > index[b].maxTimestamp) index[b].maxTimestamp = column[i];
+		}
+		length += encodeColumn(buffer + length, column, count);
+
+		// Latitude column
+		for (int i = 0; i < count; i++) column[i] = block[i].lat;
+		length += encodeColumn(buffer + length, column, count);
+
+		// Longitude column
+		for (int i = 0; i < count; i++) column[i] = block[i].lon;
+		length += encodeColumn(buffer + length, column, count);
+
+		// Speed column
+		for (int i = 0; i < count; i++) column[i] = block[i].speed;
+		length += encodeColumn(buffer + length, column, count);
+
+		index[b].offset = archiveTell(filepointer);
+		index[b].byteLength = length;
+		index[b].pointCount = count;
+		fwrite(buffer, 1, length, filepointer);
+	}
+
+	// Block index follows the last block
+	long long indexOffset = archiveTell(filepointer);
+	for (int b = 0; b < blockCount; b++) {
+		uint8_t entry[ARCHIVE_INDEX_ENTRY_SIZE];
+		putU64(entry, (uint64_t)index[b].minTimestamp);
+		putU64(entry + 8, (uint64_t)index[b].maxTimestamp);
+		putU64(entry + 16, (uint64_t)index[b].offset);
+		putU32(entry + 24, (uint32_t)index[b].byteLength);
+		putU32(entry + 28, (uint32_t)index[b].pointCount);
+		fwrite(entry, 1, sizeof(entry), filepointer);
+	}
+
+	memcpy(header, ARCHIVE_MAGIC, 4);
+	putU32(header + 4, ARCHIVE_VERSION);
+	putU32(header + 8, (uint32_t)blockCount);
+	putU32(header + 12, (uint32_t)numPoints);
+	putU64(header + 16, (uint64_t)indexOffset);
+	archiveSeek(filepointer, 0, SEEK_SET);
+	fwrite(header, 1, sizeof(header), filepointer);
+	archiveSeek(filepointer, 0, SEEK_END);
+
+	int failed = ferror(filepointer);
+
+	free(index);
+	free(buffer);
+	free(column);
+
+	if (failed) {
+		printf("Error writing archive file.\n");
+		return -1;
+	}
+	return blockCount;
+}
+
+// Shared reader for full and date-ranged loads. Blocks whose time range lies outside
+// [rangeStart, rangeEnd) are skipped without being read or decoded.
+static int readArchive(FILE* filepointer, long long rangeStart, long long rangeEnd, ESPDataPoint* data, int maxPoints) {
+	if (filepointer == NULL) {
+		printf("Error opening archive file.\n");
+		return -1;
+	}
+
+	uint8_t header[ARCHIVE_HEADER_SIZE];
+	archiveSeek(filepointer, 0, SEEK_SET);
+	if (fread(header, 1, sizeof(header), filepointer) != sizeof(header) || memcmp(header, ARCHIVE_MAGIC, 4) != 0) {
+		printf("File is not an ESP data archive.\n");
+		return -1;
+	}
+	if (getU32(header + 4) != ARCHIVE_VERSION) {
+		printf("Unsupported archive version %u.\n", getU32(header + 4));
+		return -1;
+	}
+
+	int blockCount = (int)getU32(header + 8);
+	long long indexOffset = (long long)getU64(header + 16);
+
+	archiveSeek(filepointer, 0, SEEK_END);
+	long long fileSize = archiveTell(filepointer);
+
+	// The index must sit between the blocks and the end of the file
+	if (blockCount < 0 || indexOffset < ARCHIVE_HEADER_SIZE || indexOffset > fileSize ||
+		(long long)blockCount * ARCHIVE_INDEX_ENTRY_SIZE > fileSize - indexOffset) {
+		printf("Corrupt archive header.\n");
+		return -1;
+	}
+
+	if (getESPDataVerbose()) printf("Reading ESP archive (%d blocks)...\n", blockCount);
+
+	uint8_t* indexData = (uint8_t*)malloc((blockCount > 0 ? blockCount : 1) * ARCHIVE_INDEX_ENTRY_SIZE);
+	uint8_t* buffer = (uint8_t*)malloc(ARCHIVE_BLOCK_POINTS * ARCHIVE_NUM_COLUMNS * ARCHIVE_MAX_VARINT_BYTES);
+	int64_t* timestamps = (int64_t*)malloc(ARCHIVE_BLOCK_POINTS * sizeof(int64_t));
+	int64_t* column = (int64_t*)malloc(ARCHIVE_BLOCK_POINTS * sizeof(int64_t));
+	ESPDataPoint* scratch = (ESPDataPoint*)malloc(ARCHIVE_BLOCK_POINTS * sizeof(ESPDataPoint));
+
+	if (!indexData || !buffer || !timestamps || !column || !scratch) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		free(indexData);
+		free(buffer);
+		free(timestamps);
+		free(column);
+		free(scratch);
+		return -1;
+	}
+
+	int count = 0;
+	int skippedBlocks = 0;
+
+	// The whole index is small (32 bytes per block), read it in one go
+	archiveSeek(filepointer, indexOffset, SEEK_SET);
+	if (fread(indexData, ARCHIVE_INDEX_ENTRY_SIZE, blockCount, filepointer) != (size_t)blockCount) {
+		printf("Archive index is truncated.\n");
+		blockCount = 0;
+	}
+
+	for (int b = 0; b < blockCount; b++) {
+		uint8_t* entry = indexData + b * ARCHIVE_INDEX_ENTRY_SIZE;
+
+		ArchiveBlockIndex block;
+		block.minTimestamp = (long long)getU64(entry);
+		block.maxTimestamp = (long long)getU64(entry + 8);
+		block.offset = (long long)getU64(entry + 16);
+		block.byteLength = (int)getU32(entry + 24);
+		block.pointCount = (int)getU32(entry + 28);
+
+		// Skip blocks entirely outside the requested range
+		if (block.maxTimestamp < rangeStart || block.minTimestamp >= rangeEnd) {
+			skippedBlocks++;
+			continue;
+		}
+
+		// Blocks are never empty and always lie between the header and the index
+		if (block.pointCount <= 0 || block.pointCount > ARCHIVE_BLOCK_POINTS ||
+			block.byteLength <= 0 || block.byteLength > ARCHIVE_BLOCK_POINTS * ARCHIVE_NUM_COLUMNS * ARCHIVE_MAX_VARINT_BYTES ||
+			block.offset < ARCHIVE_HEADER_SIZE || block.offset > indexOffset - block.byteLength) {
+			printf("Corrupt archive block %d.\n", b);
+			break;
+		}
+
+		archiveSeek(filepointer, block.offset, SEEK_SET);
+		if (fread(buffer, 1, block.byteLength, filepointer) != (size_t)block.byteLength) {
+			printf("Archive block %d is truncated.\n", b);
+			break;
+		}
+
+		// Decode straight into the caller's buffer when the whole block fits, otherwise into scratch space
+		int fits = count + block.pointCount <= maxPoints;
+		ESPDataPoint* dest = fits ? data + count : scratch;
+		const uint8_t* cursor = buffer;
+		const uint8_t* end = buffer + block.byteLength;
+		int used;
+
+		used = decodeColumn(cursor, end, timestamps, block.pointCount);
+		cursor += used;
+		int corrupt = (used == 0);
+
+		for (int i = 0; i < block.pointCount && !corrupt; i++) dest[i].timestamp = timestamps[i];
+
+		used = corrupt ? 0 : decodeColumn(cursor, end, column, block.pointCount);
+		cursor += used;
+		corrupt = corrupt || used == 0;
+		for (int i = 0; i < block.pointCount && !corrupt; i++) dest[i].lat = (int)column[i];
+
+		used = corrupt ? 0 : decodeColumn(cursor, end, column, block.pointCount);
+		cursor += used;
+		corrupt = corrupt || used == 0;
+		for (int i = 0; i < block.pointCount && !corrupt; i++) dest[i].lon = (int)column[i];
+
+		used = corrupt ? 0 : decodeColumn(cursor, end, column, block.pointCount);
+		corrupt = corrupt || used == 0;
+		for (int i = 0; i < block.pointCount && !corrupt; i++) dest[i].speed = (short)column[i];
+
+		if (corrupt) {
+			printf("Corrupt archive block %d.\n", b);
+			break;
+		}
+
+		// Keep only points inside the range, compacting them into the caller's buffer
+		int full = 0;
+		for (int i = 0; i < block.pointCount; i++) {
+			if (timestamps[i] < rangeStart || timestamps[i] >= rangeEnd) continue;
+			if (count >= maxPoints) {
+				full = 1;
+				break;
+			}
+			data[count++] = dest[i];
+		}
+		if (full) {
+			printf("Maximum ESP data points reached. Some data may not be read.\n");
+			break;
+		}
+	}
+
+	if (skippedBlocks > 0) {
+		printf("Skipped %d of %d archive blocks outside the requested range.\n", skippedBlocks, blockCount);
+	}
+
+	free(indexData);
+	free(buffer);
+	free(timestamps);
+	free(column);
+	free(scratch);
+
+	return count;
+}
+
+int readGPSArchive(FILE* filepointer, ESPDataPoint* data, int maxPoints) {
+	return readArchive(filepointer, LLONG_MIN, LLONG_MAX, data, maxPoints);
+}
+
+// Read only the points whose local date (see TIME_OFFSET) lies within the inclusive date range
+int readGPSArchiveRange(FILE* filepointer, int startYear, int startMonth, int startDay, int endYear, int endMonth, int endDay, ESPDataPoint* data, int maxPoints) {
+	long long rangeStart = daysFromCivil(startYear, startMonth, startDay) * 86400 + TIME_OFFSET * 3600;
+	long long rangeEnd = (daysFromCivil(endYear, endMonth, endDay) + 1) * 86400 + TIME_OFFSET * 3600;
+	return readArchive(filepointer, rangeStart, rangeEnd, data, maxPoints);
+}
@@ -0,0 +1,29 @@
+#ifndef GPS_ARCHIVE_H
+#define GPS_ARCHIVE_H
+
+#include <stdio.h>
+
+#include "esp_data.h"
+
+#define ARCHIVE_MAGIC "GPSA"       // First four bytes of every archive file
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER_SIZE 24     // Magic, version, block count, point count, index offset
+#define ARCHIVE_BLOCK_POINTS 4096  // Points per compressed block (~1 hour of data at 1-second intervals)
+#define ARCHIVE_COORD_SCALE 10000000 // Lat/lon stored as fixed-point integers of 1e-7 degrees
+#define ARCHIVE_SPEED_SCALE 100      // Speed stored as fixed-point integers of 0.01 km/h
+
+// Index entry for one compressed block, stored at the end of the archive
+typedef struct {
+	long long minTimestamp; // UTC epoch seconds of the earliest point in the block
+	long long maxTimestamp; // UTC epoch seconds of the latest point in the block
+	long long offset;       // File offset of the block payload
+	int byteLength;         // Size of the block payload in bytes
+	int pointCount;         // Number of points encoded in the block
+} ArchiveBlockIndex;
+
+int isGPSArchive(FILE* filepointer);
+int writeGPSArchive(FILE* filepointer, ESPDataPoint* data, int numPoints);
+int readGPSArchive(FILE* filepointer, ESPDataPoint* data, int maxPoints);
+int readGPSArchiveRange(FILE* filepointer, int startYear, int startMonth, int startDay, int endYear, int endMonth, int endDay, ESPDataPoint* data, int maxPoints);
+
+#endif // gps_archive_h
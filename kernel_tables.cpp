@@ -0,0 +1,196 @@
+#include "kernel_tables.h"
+
+#include <string.h>
+
+KernelTables* createKernelTables() {
+	KernelTables* tables = (KernelTables*)malloc(sizeof(KernelTables));
+	if (tables) {
+		memset(tables, 0, sizeof(KernelTables));
+	}
+	return tables;
+}
+
+void freeKernelTables(KernelTables* tables) {
+	free(tables);
+}
+
+// Find the table row for a segment id, or -1 if the traversal belongs to an unknown segment
+static int segmentIndexOf(KernelTables* tables, int segment_id) {
+	for (int i = 0; i < tables->numSegments; i++) {
+		if (tables->segmentIds[i] == segment_id) return i;
+	}
+	return -1;
+}
+
+// Fold one traversal into its segment's tables. The time-of-day weight is a Gaussian, so along
+// the table grid it is evaluated with a multiplicative recurrence instead of an exp per entry:
+// g(x + h) = g(x) * r, with the ratio r itself shrinking by exp(-h^2 / sigma^2) every step.
+static void addTraversal(KernelTables* tables, int segmentIndex, ValidTraversal* t) {
+	double sigmaSquared = tables->params.timeSigmaSeconds * tables->params.timeSigmaSeconds;
+	double h = KERNEL_STEP_SECONDS;
+	double ratioDecay = exp(-h * h / sigmaSquared);
+
+	// Day-of-week and date weights are constant for a fixed reference date
+	double constantWeight = dayOfWeekWeight(getDayOfWeek(t), tables->targetDOW, &tables->params) * dateDecayWeight(t, tables->targetYear, tables->targetMonth, tables->targetDay, &tables->params);
+	double duration = (double)t->duration;
+
+	double* sumWeights = tables->sumWeights[segmentIndex];
+	double* sumDurations = tables->sumDurations[segmentIndex];
+	double* sumSquares = tables->sumSquares[segmentIndex];
+
+	int startStep = t->startTime / KERNEL_STEP_SECONDS;
+	double offset = t->startTime - startStep * h; // Seconds past the grid point at or below the start time
+
+	// Walk down from the start step, then up from the step after it; each side covers half a day
+	for (int direction = 0; direction < 2; direction++) {
+		double x = (direction == 0) ? offset : h - offset; // Distance to the first grid point
+		double weight = exp(-0.5 * x * x / sigmaSquared);
+		double ratio = exp(-(x * h + 0.5 * h * h) / sigmaSquared);
+
+		for (int k = 0; k < KERNEL_TABLE_STEPS / 2; k++) {
+			int step = (direction == 0) ? startStep - k : startStep + 1 + k;
+			step = ((step % KERNEL_TABLE_STEPS) + KERNEL_TABLE_STEPS) % KERNEL_TABLE_STEPS;
+
+			double w = constantWeight * weight;
+			sumWeights[step] += w;
+			sumDurations[step] += w * duration;
+			sumSquares[step] += w * duration * duration;
+
+			weight *= ratio;
+			ratio *= ratioDecay;
+		}
+	}
+}
+
+// Weighted mean and variance from the three weighted sums, as in weightedMeanAndStd
+static void meanAndVariance(double sumWeights, double sumDurations, double sumSquares, double* mean, double* variance) {
+	if (sumWeights <= 0.0) { // Same convention as weightedMeanAndStd for segments without data
+		*mean = 0.0;
+		*variance = 0.0;
+		return;
+	}
+	*mean = sumDurations / sumWeights;
+	*variance = sumSquares / sumWeights - *mean * *mean;
+	if (*variance < 0.0) *variance = 0.0;
+}
+
+// Clear the tables and set the reference date and parameters they are built for
+static void resetKernelTables(KernelTables* tables, Segment* segments, int numSegments, int targetYear, int targetMonth, int targetDay, int targetDOW, ModelParams* params) {
+	memset(tables, 0, sizeof(KernelTables));
+
+	tables->numSegments = (numSegments < NUM_SEGMENTS) ? numSegments : NUM_SEGMENTS;
+	for (int i = 0; i < tables->numSegments; i++) {
+		tables->segmentIds[i] = segments[i].segment_id;
+	}
+	tables->targetYear = targetYear;
+	tables->targetMonth = targetMonth;
+	tables->targetDay = targetDay;
+	tables->targetDOW = targetDOW;
+	tables->params = *params;
+}
+
+static int sameModelParams(ModelParams* a, ModelParams* b) {
+	return a->halfLifeDays == b->halfLifeDays && a->timeSigmaSeconds == b->timeSigmaSeconds && a->sameDOWWeight == b->sameDOWWeight &&
+		a->adjacentDOWWeight == b->adjacentDOWWeight && a->dayClassWeight == b->dayClassWeight;
+}
+
+void buildKernelTables(KernelTables* tables, Segment* segments, int numSegments, TraversalStore* traversals, int targetYear, int targetMonth, int targetDay, int targetDOW, ModelParams* params) {
+	resetKernelTables(tables, segments, numSegments, targetYear, targetMonth, targetDay, targetDOW, params);
+	updateKernelTables(tables, segments, numSegments, traversals, targetYear, targetMonth, targetDay, targetDOW, params);
+}
+
+// Bring the tables up to date with the traversal history. Since the tables are plain weighted sums,
+// newly arrived traversals are added on top; a full rebuild only happens when the reference date or
+// model parameters change or the store was reloaded or replaced (its generation changed).
+void updateKernelTables(KernelTables* tables, Segment* segments, int numSegments, TraversalStore* traversals, int targetYear, int targetMonth, int targetDay, int targetDOW, ModelParams* params) {
+	if (tables->numSegments == 0 || tables->targetYear != targetYear || tables->targetMonth != targetMonth ||
+		tables->targetDay != targetDay || tables->targetDOW != targetDOW || traversals->generation != tables->builtGeneration || traversals->count < tables->builtCount || !sameModelParams(&tables->params, params)) {
+		resetKernelTables(tables, segments, numSegments, targetYear, targetMonth, targetDay, targetDOW, params);
+		tables->builtGeneration = traversals->generation;
+	}
+
+	for (int i = tables->builtCount; i < traversals->count; i++) {
+		ValidTraversal* t = traversalAt(traversals, i);
+		int segmentIndex = segmentIndexOf(tables, t->segment_id);
+		if (segmentIndex >= 0) {
+			addTraversal(tables, segmentIndex, t);
+		}
+	}
+	tables->builtCount = traversals->count;
+}
+
+// Weighted mean and variance of a segment at one table step
+void tableMeanAndVariance(KernelTables* tables, int segmentIndex, int step, double* mean, double* variance) {
+	meanAndVariance(tables->sumWeights[segmentIndex][step], tables->sumDurations[segmentIndex][step], tables->sumSquares[segmentIndex][step], mean, variance);
+}
+
+// Segment prediction at any time of day, interpolating the weighted sums between the two nearest steps
+void lookupSegmentDuration(KernelTables* tables, int segmentIndex, double targetTime, double* predictedMean, double* predictedStdDev) {
+	double position = fmod(targetTime, 86400.0) / KERNEL_STEP_SECONDS;
+	if (position < 0) position += KERNEL_TABLE_STEPS;
+
+	int step = (int)position;
+	double fraction = position - step;
+	step %= KERNEL_TABLE_STEPS;
+	int nextStep = (step + 1) % KERNEL_TABLE_STEPS;
+
+	double* sumWeights = tables->sumWeights[segmentIndex];
+	double* sumDurations = tables->sumDurations[segmentIndex];
+	double* sumSquares = tables->sumSquares[segmentIndex];
+
+	double variance;
+	meanAndVariance(sumWeights[step] + fraction * (sumWeights[nextStep] - sumWeights[step]),
+		sumDurations[step] + fraction * (sumDurations[nextStep] - sumDurations[step]),
+		sumSquares[step] + fraction * (sumSquares[nextStep] - sumSquares[step]),
+		predictedMean, &variance);
+	*predictedStdDev = sqrt(variance);
+}
+
+// Table-driven equivalent of predictOverallDuration for the tables' reference date
+void predictOverallDurationTabulated(KernelTables* tables, int targetTime, double* routeMean, double* routeStddev) {
+	double totalDuration = 0.0;
+	double totalVar = 0.0;
+
+	double currentTime = targetTime;
+
+	double segmentMean = 0.0;
+	double segmentStdDev = 0.0;
+
+	for (int i = 0; i < tables->numSegments; i++) {
+		// The exact path passes the current time as whole seconds, so do the same here
+		lookupSegmentDuration(tables, i, (double)(int)currentTime, &segmentMean, &segmentStdDev);
+		totalDuration += segmentMean;
+		totalVar += segmentStdDev * segmentStdDev;
+
+		currentTime += segmentMean;
+		if (currentTime >= 86400) {
+			currentTime -= 86400; // Wrap around midnight
+		}
+	}
+
+	*routeMean = totalDuration;
+	*routeStddev = sqrt(totalVar);
+}
+
+// Report the worst-case and average difference between tabulated and exact route predictions, sampled every stepSeconds
+void compareKernelTables(KernelTables* tables, Segment* segments, TraversalStore* traversals, int stepSeconds, double* maxMeanError, double* maxStdError, double* avgMeanError) {
+	int samples = 0;
+
+	*maxMeanError = 0.0;
+	*maxStdError = 0.0;
+	*avgMeanError = 0.0;
+
+	for (int t = 0; t < 86400; t += stepSeconds) {
+		double exactMean, exactStddev, tableMean, tableStddev;
+
+		predictOverallDuration(segments, traversals, t, tables->targetDay, tables->targetMonth, tables->targetYear, tables->targetDOW, &exactMean, &exactStddev, &tables->params);
+		predictOverallDurationTabulated(tables, t, &tableMean, &tableStddev);
+
+		if (fabs(exactMean - tableMean) > *maxMeanError) *maxMeanError = fabs(exactMean - tableMean);
+		if (fabs(exactStddev - tableStddev) > *maxStdError) *maxStdError = fabs(exactStddev - tableStddev);
+		*avgMeanError += fabs(exactMean - tableMean);
+		samples++;
+	}
+
+	if (samples > 0) *avgMeanError /= samples;
+}
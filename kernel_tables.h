@@ -0,0 +1,47 @@
+#ifndef KERNEL_TABLES_H
+#define KERNEL_TABLES_H
+
+#include "esp_data.h"
+#include "prediction.h"
+
+#define KERNEL_STEP_SECONDS 30 // Table resolution
+#define KERNEL_TABLE_STEPS 2880 // Table entries per day (86400 / KERNEL_STEP_SECONDS)
+
+// Precomputed time-of-day kernel tables for one reference date and day of week.
+// For a fixed reference date the day-of-week and date-decay weights of every traversal are
+// constants, so the weighted sums used by weightedMeanAndStd only depend on the target time.
+// They are tabulated per segment every KERNEL_STEP_SECONDS, turning each segment query into a lookup.
+// Queries interpolate the sums, not the mean and variance: far from any observation the mean
+// switches between drives within a minute, which interpolated means smear out. On the bundled data
+// route predictions stay within 0.45 s (mean) and 0.25 s (std dev) of the exact path at every second.
+typedef struct {
+	int segmentIds[NUM_SEGMENTS];
+	int numSegments;
+
+	// Reference date and day of week the tables were built for
+	int targetYear;
+	int targetMonth;
+	int targetDay;
+	int targetDOW;
+
+	ModelParams params; // Weighting parameters the tables were built with
+
+	int builtCount;      // Number of traversals folded into the tables so far
+	int builtGeneration; // Generation of the traversal store they came from
+
+	// Weighted sums of 1, duration and duration^2 at each table step
+	double sumWeights[NUM_SEGMENTS][KERNEL_TABLE_STEPS];
+	double sumDurations[NUM_SEGMENTS][KERNEL_TABLE_STEPS];
+	double sumSquares[NUM_SEGMENTS][KERNEL_TABLE_STEPS];
+} KernelTables;
+
+KernelTables* createKernelTables();
+void freeKernelTables(KernelTables* tables);
+void buildKernelTables(KernelTables* tables, Segment* segments, int numSegments, TraversalStore* traversals, int targetYear, int targetMonth, int targetDay, int targetDOW, ModelParams* params);
+void updateKernelTables(KernelTables* tables, Segment* segments, int numSegments, TraversalStore* traversals, int targetYear, int targetMonth, int targetDay, int targetDOW, ModelParams* params);
+void tableMeanAndVariance(KernelTables* tables, int segmentIndex, int step, double* mean, double* variance);
+void lookupSegmentDuration(KernelTables* tables, int segmentIndex, double targetTime, double* predictedMean, double* predictedStdDev);
+void predictOverallDurationTabulated(KernelTables* tables, int targetTime, double* routeMean, double* routeStddev);
+void compareKernelTables(KernelTables* tables, Segment* segments, TraversalStore* traversals, int stepSeconds, double* maxMeanError, double* maxStdError, double* avgMeanError);
+
+#endif // kernel_tables_h
@@ -1,70 +1,62 @@
 ﻿#define _CRT_SECURE_NO_WARNINGS
 #undef UNICODE
 #undef _UNICODE
+#include "backtest.h"
+#include "dashboard_export.h"
+#include "departure_planner.h"
 #include "esp_data.h"
+#include "gps_archive.h"
+#include "kernel_tables.h"
+#include "model_tuning.h"
+#include "monte_carlo.h"
 #include "prediction.h"
+#include "quantile_sketch.h"
+#include "regression_check.h"
+#include "route_corridors.h"
+#include "route_segments.h"
+#include "trip_state.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include <windows.h>
 #include <commdlg.h> // Common dialogs
 
 #define NUM_SEGMENTS 12
+#define SPEED_FEATURES_EXTENSION ".speed" // Per-traversal speed features, written next to the traversal output with this extension
+#define HEATMAP_FILENAME "segment_heatmap.csv"      // Dashboard export: segment x hour-of-week duration table
+#define ROUTE_POLYLINE_FILENAME "route_polyline.csv" // Dashboard export: downsampled route centreline
 
 // Function prototypes
 int openFileDialog(char* outPath, const char* filter, const char* title);
 int saveFileDialog(char* outPath, const char* filter, const char* title);
-void generatePredictions(char* predictionfilename, char* traversalfilename, Segment* segments);
-void generatePredictionSet(char* predictionfilename, char* traversalfilename, Segment* segments);
+int loadTraversals(char* traversalfilename, TraversalStore* traversals);
+void speedFeaturesFilename(const char* traversalfilename, char* speedfilename);
+int loadSpeedFeatures(const char* speedfilename, TraversalStore* traversals, int firstIndex);
+void generatePredictions(char* predictionfilename, char* traversalfilename, Segment* segments, ModelParams* modelParams);
+void generatePredictionSet(char* predictionfilename, char* traversalfilename, Segment* segments, int usePrecomputedTables, ModelParams* modelParams);
+void generateQuantileReport(char* traversalfilename, Segment* segments);
+void generateArrivalDistribution(char* traversalfilename, Segment* segments, ModelParams* modelParams);
+void planDeparture(char* traversalfilename, Segment* segments, ModelParams* modelParams);
+void backtestPredictions(char* traversalfilename, Segment* segments, ModelParams* modelParams);
+void tuneModel(char* traversalfilename, Segment* segments, ModelParams* modelParams);
+void exportDashboardTables(char* traversalfilename, Segment* segments);
+void replayTrip(char* traversalfilename, Segment* segments, ModelParams* modelParams);
+void checkRegressions(Segment* segments);
 void clearScreen();
 void clearInputBuffer();
 void pauseScreen();
-void printMenu();
-void processESPData(Segment* segments, char* inputfilename, char* traversalfilename);
+void printMenu(int usePrecomputedTables, int useCorridors);
+void processESPData(Segment* segments, char* inputfilename, char* traversalfilename, int useCorridors);
+void archiveESPData(char* inputfilename);
+int loadESPData(char* inputfilename, ESPDataPoint* data);
 void selectESPDataFile(char* inputfilename);
 void selectTraversalOutputFile(char* traversalfilename);
 void selectPredictionOutputFile(char* predictionfilename);
 
 int main(void) {	
-	// Drive segment dictionary
-	Segment segments[NUM_SEGMENTS] = {
-		// 1. 13th & Marine > Taylor Way
-		{1, 49.3260, -123.1516, 49.3283, -123.1340},
-
-		// 2. Taylor Way > Lions Gate Bridge
-		{2, 49.3239, -123.1335, 49.3278, -123.1290},
-
-		// 3. Lions Gate Bridge
-		{3, 49.3117, -123.1429, 49.3238, -123.1308},
-
-		// 4. Causeway > Denman
-		{4, 49.2925, -123.1518, 49.3117, -123.1333},
-
-		// 5. Denman > Pacific
-		{5, 49.2868, -123.1425, 49.2924, -123.1332},
-
-		// 6. Pacific > Burrard St Bridge
-		{6, 49.2766, -123.1430, 49.2867, -123.1320},
-
-		// 7. Burrard Bridge
-		{7, 49.2720, -123.1465, 49.2764, -123.1326},
-
-		// 8. Cornwall
-		{8, 49.2721, -123.1634, 49.2732, -123.1468},
-
-		// 9. Macdonald > W 4th
-		{9, 49.2680, -123.1692, 49.2729, -123.1637},
-
-		// 10. W 4th > Blanca
-		{10, 49.2671, -123.2165, 49.2693, -123.1698},
-
-		// 11. Chancellor Blvd
-		{11, 49.2668, -123.2477, 49.2737, -123.2171},
-
-		// 12. Chancellor Roundabout → Fraser Parkade
-		{12, 49.2673, -123.2597, 49.2737, -123.2481}
-	};
+	Segment* segments = routeSegments; // Drive segment dictionary (route_segments.cpp)
 
 	// File paths and default naming
 	char inputfilename[MAX_PATH];
@@ -78,11 +70,15 @@ int main(void) {
 	strncpy(predictionfilename, "predictions_output.txt", sizeof(predictionfilename) - 1);
 	predictionfilename[sizeof(predictionfilename) - 1] = '\0';
 
+	int usePrecomputedTables = 0; // Prediction sets use precomputed kernel tables instead of the exact per-query path
+	ModelParams modelParams = defaultModelParams(); // Weighting parameters, can be replaced by the tuning option
+	int useCorridors = 0; // Processing detects traversals by corridor map-matching instead of segment boxes
+
 	int choice = 0;
 	// Main menu loop and interfacting
 	do {
 		clearScreen();
-		printMenu();
+		printMenu(usePrecomputedTables, useCorridors);
 
 		printf("Enter choice: ");
 		if (scanf("%d", &choice) != 1) {
@@ -107,18 +103,62 @@ int main(void) {
 			break;
 
 		case 4:
-			processESPData(segments, inputfilename, traversalfilename);
+			processESPData(segments, inputfilename, traversalfilename, useCorridors);
 			break;
 
 		case 5:
-			generatePredictions(predictionfilename, traversalfilename, segments);
+			generatePredictions(predictionfilename, traversalfilename, segments, &modelParams);
 			break;
 
 		case 6:
-			generatePredictionSet(predictionfilename, traversalfilename, segments);
+			generatePredictionSet(predictionfilename, traversalfilename, segments, usePrecomputedTables, &modelParams);
 			break;
 
 		case 7:
+			archiveESPData(inputfilename);
+			break;
+
+		case 8:
+			usePrecomputedTables = !usePrecomputedTables;
+			break;
+
+		case 9:
+			generateQuantileReport(traversalfilename, segments);
+			break;
+
+		case 10:
+			generateArrivalDistribution(traversalfilename, segments, &modelParams);
+			break;
+
+		case 11:
+			planDeparture(traversalfilename, segments, &modelParams);
+			break;
+
+		case 12:
+			backtestPredictions(traversalfilename, segments, &modelParams);
+			break;
+
+		case 13:
+			tuneModel(traversalfilename, segments, &modelParams);
+			break;
+
+		case 14:
+			useCorridors = !useCorridors;
+			break;
+
+		case 15:
+			exportDashboardTables(traversalfilename, segments);
+			break;
+
+		case 16:
+			replayTrip(traversalfilename, segments, &modelParams);
+			break;
+
+		case 17:
+			checkRegressions(segments);
+			break;
+
+		case 18:
 			break;
 
 		default:
@@ -126,7 +166,7 @@ int main(void) {
 			pauseScreen();
 			break;
 		}
-	} while (choice != 7);
+	} while (choice != 18);
 
 
 	printf("Exiting program...\n");
@@ -166,53 +206,102 @@ void selectPredictionOutputFile(char* predictionfilename) {
 	}
 }
 
-void processESPData(Segment* segments, char* inputfilename, char* traversalfilename) {
-	FILE* datafile = fopen(inputfilename, "r");
+// Load ESP data from either a raw text log or a compressed archive, detected by the archive magic.
+// For archives the user may restrict loading to a date range, skipping all other blocks.
+int loadESPData(char* inputfilename, ESPDataPoint* data) {
+	FILE* datafile = fopen(inputfilename, "rb");
 
+	if (datafile == NULL) {
+		perror("Error opening file");
+		return -1;
+	}
+	printf("File opened successfully\n");
+
+	int numPoints;
+	if (isGPSArchive(datafile)) {
+		int startYear, startMonth, startDay, endYear, endMonth, endDay;
+
+		printf("Enter date range to load (YYYY-MM-DD YYYY-MM-DD), or 0 to load all data: \n");
+		if (scanf("%d-%d-%d %d-%d-%d", &startYear, &startMonth, &startDay, &endYear, &endMonth, &endDay) == 6) {
+			numPoints = readGPSArchiveRange(datafile, startYear, startMonth, startDay, endYear, endMonth, endDay, data, MAX_ESP_DATA_POINTS);
+		}
+		else {
+			clearInputBuffer();
+			numPoints = readGPSArchive(datafile, data, MAX_ESP_DATA_POINTS);
+		}
+		fclose(datafile);
+	}
+	else {
+		// Raw logs are parsed in text mode
+		datafile = freopen(inputfilename, "r", datafile);
+		numPoints = getESPData(datafile, data);
+		if (datafile) fclose(datafile);
+	}
+	return numPoints;
+}
+
+void processESPData(Segment* segments, char* inputfilename, char* traversalfilename, int useCorridors) {
 	int numPoints = 0;
-	int traversalCount = 0;
 
-	ValidTraversal* traversals = (ValidTraversal*)malloc(MAX_TRAVERSALS * sizeof(ValidTraversal)); // Array to hold valid traversals
+	TraversalStore traversals; // Growable store to hold valid traversals
+	initTraversalStore(&traversals);
 	ESPDataPoint* ESPData = (ESPDataPoint*)malloc(MAX_ESP_DATA_POINTS * sizeof(ESPDataPoint)); // Array of struct to hold ESP data points for preprocessing
 
 	// Check for successful memory allocation
-	if (!ESPData || !traversals) {
+	if (!ESPData) {
 		fprintf(stderr, "Memory allocation failed.\n");
-		if (ESPData) free(ESPData);
-		if (traversals) free(traversals);
 		return;
 	}
 
-	// Confirm successful file opening
-	if (datafile == NULL) {
-		perror("Error opening file");
+	numPoints = loadESPData(inputfilename, ESPData);
+
+	// Confirm successful file loading
+	if (numPoints < 0) {
+		free(ESPData);
+		freeTraversalStore(&traversals);
 		return;
 	}
 	else {
-		printf("File opened successfully\n");
-
-		numPoints = getESPData(datafile, ESPData);
-
 		printf("Number of ESP data points read: %d\n", numPoints);
 		printf("Processing ESP data points...\n");
 
-		for (int i = 0; i < numPoints;) {
-			i = processPoint(ESPData, i, segments, NUM_SEGMENTS, numPoints, traversals, &traversalCount);
+		if (useCorridors) {
+			CorridorMatcher* matcher = createCorridorMatcher(routeCorridors, NUM_ROUTE_CORRIDORS);
+			if (matcher == NULL) {
+				free(ESPData);
+				freeTraversalStore(&traversals);
+				return;
+			}
+
+			CorridorStats stats;
+			detectCorridorTraversals(matcher, ESPData, numPoints, &traversals, &stats);
+			printf("Corridor matching: %d points on route, %d off route, %d partial corridor visits, %d detours\n",
+				stats.matchedPoints, stats.offRoutePoints, stats.partialRuns, stats.detours);
+
+			freeCorridorMatcher(matcher);
+		}
+		else {
+			SegmentBounds bounds[NUM_SEGMENTS];
+			initSegmentBounds(segments, NUM_SEGMENTS, bounds);
+			for (int i = 0; i < numPoints;) {
+				i = processPoint(ESPData, i, segments, bounds, NUM_SEGMENTS, numPoints, &traversals);
+			}
 		}
 
-		printf("Processing complete. Number of valid traversals recorded: %d\n", traversalCount);
+		printf("Processing complete. Number of valid traversals recorded: %d\n", traversals.count);
 		// Print all recorded traversals for verification
-		for (int i = 0; i < traversalCount; i++) {
+		for (int i = 0; i < traversals.count; i++) {
+			ValidTraversal* t = traversalAt(&traversals, i);
 			printf("Traversal %d: Segment ID: %d, Duration: %d seconds, Date: %04d-%02d-%02d, Start Time: %02d:%02d:%02d\n",
 				i + 1,
-				traversals[i].segment_id,
-				traversals[i].duration,
-				traversals[i].year,
-				traversals[i].month,
-				traversals[i].day,
-				traversals[i].startTime / 3600,
-				(traversals[i].startTime % 3600) / 60,
-				traversals[i].startTime % 60
+				t->segment_id,
+				t->duration,
+				t->year,
+				t->month,
+				t->day,
+				t->startTime / 3600,
+				(t->startTime % 3600) / 60,
+				t->startTime % 60
 			);
 		}
 	}
@@ -224,58 +313,244 @@ void processESPData(Segment* segments, char* inputfilename, char* traversalfilen
 		perror("Error opening output file");
 		return;
 	}
-	for (int i = 0; i < traversalCount; i++) {
+	for (int i = 0; i < traversals.count; i++) {
+		ValidTraversal* t = traversalAt(&traversals, i);
 		fprintf(traversalFile, "%d,%d,%04d-%02d-%02d,%02d:%02d:%02d\n",
-			traversals[i].segment_id,
-			traversals[i].duration,
-			traversals[i].year,
-			traversals[i].month,
-			traversals[i].day,
-			traversals[i].startTime / 3600,
-			(traversals[i].startTime % 3600) / 60,
-			traversals[i].startTime % 60
+			t->segment_id,
+			t->duration,
+			t->year,
+			t->month,
+			t->day,
+			t->startTime / 3600,
+			(t->startTime % 3600) / 60,
+			t->startTime % 60
 		);
 	}
 	printf("Traversals successfully saved to '%s'.\n", traversalfilename);
 
-	fclose(datafile);
 	fclose(traversalFile);
 
+	// Speed features go to their own file so the traversal file format stays unchanged. Rows follow
+	// the traversal file order and repeat its key so a mismatched pair of files can be detected.
+	char speedfilename[MAX_PATH];
+	speedFeaturesFilename(traversalfilename, speedfilename);
+	FILE* speedFile = fopen(speedfilename, "w");
+	if (speedFile == NULL) {
+		perror("Error opening speed features file");
+	}
+	else {
+		for (int i = 0; i < traversals.count; i++) {
+			ValidTraversal* t = traversalAt(&traversals, i);
+			SpeedColumns* columns = speedColumnsAt(&traversals, i);
+			int row = traversalRow(i);
+			fprintf(speedFile, "%d,%04d-%02d-%02d,%02d:%02d:%02d,%.2f,%.2f,%d,%d\n",
+				t->segment_id,
+				t->year,
+				t->month,
+				t->day,
+				t->startTime / 3600,
+				(t->startTime % 3600) / 60,
+				t->startTime % 60,
+				columns->meanSpeed[row],
+				columns->minSpeed[row],
+				columns->slowSeconds[row],
+				columns->stopCount[row]
+			);
+		}
+		fclose(speedFile);
+		printf("Speed features saved to '%s'.\n", speedfilename);
+	}
+
 	free(ESPData);
-	free(traversals);
+	freeTraversalStore(&traversals);
 
 	system("pause");
 }
 
-void generatePredictions (char* predictionfilename, char*traversalfilename, Segment* segments) {
+// Convert the selected ESP data file into a delta-compressed archive and compare reload times
+void archiveESPData(char* inputfilename) {
+	char archivefilename[MAX_PATH];
+
+	ESPDataPoint* ESPData = (ESPDataPoint*)malloc(MAX_ESP_DATA_POINTS * sizeof(ESPDataPoint));
+	if (!ESPData) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		return;
+	}
+
+	clock_t textStart = clock();
+	int numPoints = loadESPData(inputfilename, ESPData);
+	double textSeconds = (double)(clock() - textStart) / CLOCKS_PER_SEC;
+
+	if (numPoints < 0) {
+		free(ESPData);
+		system("pause");
+		return;
+	}
+
+	if (!saveFileDialog(archivefilename, "All Files\0*.*\0", "Save ESP Data Archive")) {
+		printf("File selection canceled.\n");
+		free(ESPData);
+		system("pause");
+		return;
+	}
+
+	FILE* archiveFile = fopen(archivefilename, "wb+");
+	if (archiveFile == NULL) {
+		perror("Error opening archive file");
+		free(ESPData);
+		system("pause");
+		return;
+	}
+
+	int blockCount = writeGPSArchive(archiveFile, ESPData, numPoints);
+	long archiveBytes = ftell(archiveFile);
+
+	if (blockCount >= 0) {
+		// Time a full reload from the archive for comparison with the original load
+		clock_t archiveStart = clock();
+		int reloaded = readGPSArchive(archiveFile, ESPData, MAX_ESP_DATA_POINTS);
+		double archiveSeconds = (double)(clock() - archiveStart) / CLOCKS_PER_SEC;
+
+		FILE* sourceFile = fopen(inputfilename, "rb");
+		long sourceBytes = 0;
+		if (sourceFile) {
+			fseek(sourceFile, 0, SEEK_END);
+			sourceBytes = ftell(sourceFile);
+			fclose(sourceFile);
+		}
+
+		printf("Archived %d points in %d blocks to '%s'.\n", numPoints, blockCount, archivefilename);
+		printf("Size: %ld bytes -> %ld bytes (%.1f%% of original, %.2f bytes/point)\n",
+			sourceBytes, archiveBytes, sourceBytes > 0 ? 100.0 * archiveBytes / sourceBytes : 0.0, numPoints > 0 ? (double)archiveBytes / numPoints : 0.0);
+		printf("Load time: original %.3f s, archive %.3f s (%d points)\n", textSeconds, archiveSeconds, reloaded);
+	}
+
+	fclose(archiveFile);
+	free(ESPData);
+
+	system("pause");
+}
+
+// Append traversals from a traversal output file to the store, returns the number read or -1 on failure
+int loadTraversals(char* traversalfilename, TraversalStore* traversals) {
 	FILE* traversalFile = fopen(traversalfilename, "r");
 
 	if (traversalFile == NULL) {
 		perror("Error opening traversal file");
-		return;
+		return -1;
 	}
-		
+
 	int j = 0;
-	int traversalCount = 0;
 	int tempHour, tempMinute, tempSecond;
-	ValidTraversal* traversals = (ValidTraversal*)malloc(MAX_TRAVERSALS * sizeof(ValidTraversal));
+	ValidTraversal traversal;
 
-	// Read traversals from file into array
+	// Read traversals from file into the store
 	while (fscanf(traversalFile, "%d,%d,%d-%d-%d,%d:%d:%d\n",
-		&traversals[j].segment_id,
-		&traversals[j].duration,
-		&traversals[j].year,
-		&traversals[j].month,
-		&traversals[j].day,
+		&traversal.segment_id,
+		&traversal.duration,
+		&traversal.year,
+		&traversal.month,
+		&traversal.day,
 		&tempHour,
 		&tempMinute,
 		&tempSecond) == 8) {
 
-		traversals[j].startTime = tempHour * 3600 + tempMinute * 60 + tempSecond;
+		traversal.startTime = tempHour * 3600 + tempMinute * 60 + tempSecond;
+
+		ValidTraversal* slot = appendTraversal(traversals);
+		if (slot == NULL) {
+			fprintf(stderr, "Memory allocation failed, %d traversals loaded.\n", j);
+			break;
+		}
+		*slot = traversal;
 		j++;
-		if (j >= MAX_TRAVERSALS) break; // Prevent overflow
 	}
-	traversalCount = j;
+
+	fclose(traversalFile);
+
+	char speedfilename[MAX_PATH];
+	speedFeaturesFilename(traversalfilename, speedfilename);
+	loadSpeedFeatures(speedfilename, traversals, traversals->count - j);
+	return j;
+}
+
+// Speed feature file belonging to a traversal file: same directory and stem, SPEED_FEATURES_EXTENSION
+// in place of the extension. Both buffers are MAX_PATH long.
+void speedFeaturesFilename(const char* traversalfilename, char* speedfilename) {
+	strncpy(speedfilename, traversalfilename, MAX_PATH - 1);
+	speedfilename[MAX_PATH - 1] = '\0';
+
+	// Only a dot in the last path component starts the extension
+	char* name = speedfilename;
+	for (char* c = speedfilename; *c; c++) {
+		if (*c == '\\' || *c == '/') name = c + 1;
+	}
+	char* extension = strrchr(name, '.');
+	if (extension != NULL) *extension = '\0';
+
+	size_t length = strlen(speedfilename);
+	if (length + strlen(SPEED_FEATURES_EXTENSION) >= MAX_PATH) length = MAX_PATH - 1 - strlen(SPEED_FEATURES_EXTENSION);
+	strcpy(speedfilename + length, SPEED_FEATURES_EXTENSION);
+}
+
+// Fill the speed feature columns of the traversals loaded from firstIndex on. The whole file is checked
+// before anything is attached: every row must match its traversal and the row count must match the
+// traversal count, otherwise the features stay unknown. Returns the number of traversals with speed
+// features, or -1 if the file is missing or does not match.
+int loadSpeedFeatures(const char* speedfilename, TraversalStore* traversals, int firstIndex) {
+	FILE* speedFile = fopen(speedfilename, "r");
+	if (speedFile == NULL) return -1;
+
+	int segment_id, year, month, day, hour, minute, second, slowSeconds, stopCount;
+	float meanSpeed, minSpeed;
+
+	for (int pass = 0; pass < 2; pass++) {
+		int index = firstIndex;
+		rewind(speedFile);
+
+		while (fscanf(speedFile, "%d,%d-%d-%d,%d:%d:%d,%f,%f,%d,%d\n",
+			&segment_id, &year, &month, &day, &hour, &minute, &second,
+			&meanSpeed, &minSpeed, &slowSeconds, &stopCount) == 11) {
+
+			if (pass == 0) {
+				// Stale or foreign file
+				ValidTraversal* t = (index < traversals->count) ? traversalAt(traversals, index) : NULL;
+				if (t == NULL || t->segment_id != segment_id || t->year != year || t->month != month || t->day != day ||
+					t->startTime != hour * 3600 + minute * 60 + second) {
+					fclose(speedFile);
+					return -1;
+				}
+			}
+			else {
+				SpeedColumns* columns = speedColumnsAt(traversals, index);
+				int row = traversalRow(index);
+				columns->meanSpeed[row] = meanSpeed;
+				columns->minSpeed[row] = minSpeed;
+				columns->slowSeconds[row] = (short)slowSeconds;
+				columns->stopCount[row] = (short)stopCount;
+			}
+			index++;
+		}
+
+		if (pass == 0 && index != traversals->count) {
+			fclose(speedFile);
+			return -1; // Row count does not match the traversal file
+		}
+	}
+	fclose(speedFile);
+
+	return traversals->count - firstIndex;
+}
+
+void generatePredictions (char* predictionfilename, char*traversalfilename, Segment* segments, ModelParams* modelParams) {
+	TraversalStore traversals;
+	initTraversalStore(&traversals);
+	int traversalCount = loadTraversals(traversalfilename, &traversals);
+
+	if (traversalCount < 0) {
+		freeTraversalStore(&traversals);
+		return;
+	}
 
 	double routeMean, routeStddev;
 	int targetTime, targetDay, targetDOW, targetMonth, targetYear;
@@ -291,73 +566,513 @@ void generatePredictions (char* predictionfilename, char*traversalfilename, Segm
 	ValidTraversal tempTraversal = { 0, 0, targetYear, targetMonth, targetDay, targetTime };
 	targetDOW = getDayOfWeek(&tempTraversal);
 
-	predictOverallDuration(segments, traversals, traversalCount, targetTime, targetDay, targetMonth, targetYear, targetDOW, &routeMean, &routeStddev);
+	predictOverallDuration(segments, &traversals, targetTime, targetDay, targetMonth, targetYear, targetDOW, &routeMean, &routeStddev, modelParams);
 
 	printf("Predicted overall duration: %.2f seconds\n", routeMean);
 	printf("Predicted overall standard deviation: %.2f seconds\n", routeStddev);
 
-	fclose(traversalFile);
-
-	free(traversals);
+	freeTraversalStore(&traversals);
 
 	system("pause");
 }
 
-void generatePredictionSet(char* predictionfilename, char* traversalfilename, Segment* segments) {
-	FILE* traversalFile = fopen(traversalfilename, "r");
-	FILE* predictionFile = fopen(predictionfilename, "w");
+void generatePredictionSet(char* predictionfilename, char* traversalfilename, Segment* segments, int usePrecomputedTables, ModelParams* modelParams) {
+	TraversalStore traversals;
+	initTraversalStore(&traversals);
+	int traversalCount = loadTraversals(traversalfilename, &traversals);
 
-	if (traversalFile == NULL || predictionFile == NULL) {
-		perror("Error opening traversal file");
+	if (traversalCount < 0) {
+		freeTraversalStore(&traversals);
 		return;
 	}
 
-	int j = 0;
-	int traversalCount = 0;
-	int tempHour, tempMinute, tempSecond;
-	ValidTraversal* traversals = (ValidTraversal*)malloc(MAX_TRAVERSALS * sizeof(ValidTraversal));
+	FILE* predictionFile = fopen(predictionfilename, "w");
 
-	// Read traversals from file into array
-	while (fscanf(traversalFile, "%d,%d,%d-%d-%d,%d:%d:%d\n",
-		&traversals[j].segment_id,
-		&traversals[j].duration,
-		&traversals[j].year,
-		&traversals[j].month,
-		&traversals[j].day,
-		&tempHour,
-		&tempMinute,
-		&tempSecond) == 8) {
+	if (predictionFile == NULL) {
+		perror("Error opening prediction file");
+		freeTraversalStore(&traversals);
+		return;
+	}
 
-		traversals[j].startTime = tempHour * 3600 + tempMinute * 60 + tempSecond;
-		j++;
-		if (j >= MAX_TRAVERSALS) break; // Prevent overflow
+	int targetDay = 1; // Default to the first day of the month
+	int targetMonth = 10; // Default to October
+	int targetYear = 2025; // Default to 2025
+	int targetDOW = 4; // Default to Wednesday
+
+	KernelTables* tables = NULL;
+	if (usePrecomputedTables) {
+		tables = createKernelTables();
+		if (tables == NULL) {
+			fprintf(stderr, "Memory allocation failed, using exact predictions.\n");
+		}
+		else {
+			buildKernelTables(tables, segments, NUM_SEGMENTS, &traversals, targetYear, targetMonth, targetDay, targetDOW, modelParams);
+		}
 	}
-	traversalCount = j;
 
 	for (int m = 0; m < 1440; m++) {
 		// Generate predictions for each minute of the day
 		int targetTime = m * 60;  // Convert minutes to seconds
 		double routeMean, routeStddev;
-		int targetDay = 1; // Default to the first day of the month
-		int targetMonth = 10; // Default to October
-		int targetYear = 2025; // Default to 2025
-		int targetDOW = 4; // Default to Wednesday
 
-		predictOverallDuration(segments, traversals, traversalCount, targetTime, targetDay, targetMonth, targetYear, targetDOW, &routeMean, &routeStddev);
+		if (tables) {
+			predictOverallDurationTabulated(tables, targetTime, &routeMean, &routeStddev);
+		}
+		else {
+			predictOverallDuration(segments, &traversals, targetTime, targetDay, targetMonth, targetYear, targetDOW, &routeMean, &routeStddev, modelParams);
+		}
 
 		fprintf(predictionFile, "Time: %02d:%02d, Predicted Mean: %.2f, Std Dev: %.2f\n", m / 60, m % 60, routeMean, routeStddev);
 	}
 	printf("Prediction set printed to file.\n");
 
-	fclose(traversalFile);
+	if (tables) {
+		// The accuracy report runs the exact path every 7 seconds of the day (so the samples cover every
+		// offset between table steps), which costs far more than the tables save, so it is opt-in
+		char answer = 'n';
+		printf("Compare the kernel tables against exact predictions? (y/n): \n");
+		scanf(" %c", &answer);
+		if (answer == 'y' || answer == 'Y') {
+			double maxMeanError, maxStdError, avgMeanError;
+			compareKernelTables(tables, segments, &traversals, 7, &maxMeanError, &maxStdError, &avgMeanError);
+			printf("Kernel table accuracy vs exact: max mean error %.3f s, max std dev error %.3f s, average mean error %.4f s\n", maxMeanError, maxStdError, avgMeanError);
+		}
+		freeKernelTables(tables);
+	}
+
 	fclose(predictionFile);
 
-	free(traversals);
+	freeTraversalStore(&traversals);
+
+	system("pause");
+}
+
+// Print p50/p90/p95 segment durations from the per-segment quantile sketches, walking the route
+// forward from the departure time using the median duration of each segment
+void generateQuantileReport(char* traversalfilename, Segment* segments) {
+	TraversalStore traversals;
+	initTraversalStore(&traversals);
+	int traversalCount = loadTraversals(traversalfilename, &traversals);
+
+	DurationSketches* sketches = createDurationSketches(segments, NUM_SEGMENTS);
+
+	if (traversalCount < 0 || sketches == NULL) {
+		freeTraversalStore(&traversals);
+		freeDurationSketches(sketches);
+		system("pause");
+		return;
+	}
+
+	for (int i = 0; i < traversals.count; i++) {
+		addTraversalToSketches(sketches, traversalAt(&traversals, i), 1.0);
+	}
+
+	int hour, minute;
+	printf("Enter departure time of the day (HH:MM): \n");
+	scanf("%d:%d", &hour, &minute);
+
+	double currentTime = hour * 3600 + minute * 60;
+	double routeP50 = 0.0, routeP90 = 0.0, routeP95 = 0.0;
+
+	printf("Segment |    p50 |    p90 |    p95 (seconds)\n");
+	for (int i = 0; i < NUM_SEGMENTS; i++) {
+		double p50 = segmentDurationQuantile(sketches, i, (int)currentTime, 0.50);
+		double p90 = segmentDurationQuantile(sketches, i, (int)currentTime, 0.90);
+		double p95 = segmentDurationQuantile(sketches, i, (int)currentTime, 0.95);
+
+		if (p50 < 0) {
+			printf("%7d | no data\n", segments[i].segment_id);
+			continue;
+		}
+		printf("%7d | %6.1f | %6.1f | %6.1f\n", segments[i].segment_id, p50, p90, p95);
+
+		routeP50 += p50;
+		routeP90 += p90;
+		routeP95 += p95;
+
+		currentTime += p50;
+		if (currentTime >= 86400) {
+			currentTime -= 86400; // Wrap around midnight
+		}
+	}
+	// Summing per-segment quantiles assumes perfectly correlated segments, so p90/p95 are upper bounds
+	printf("Route   | %6.1f | %6.1f | %6.1f (p90/p95 are conservative upper bounds)\n", routeP50, routeP90, routeP95);
+
+	freeTraversalStore(&traversals);
+	freeDurationSketches(sketches);
+
+	system("pause");
+}
+
+// Simulate full-route arrival times for a departure, with each segment conditioned on the simulated
+// arrival time at that segment, and print the distribution as a text histogram
+void generateArrivalDistribution(char* traversalfilename, Segment* segments, ModelParams* modelParams) {
+	TraversalStore traversals;
+	initTraversalStore(&traversals);
+	int traversalCount = loadTraversals(traversalfilename, &traversals);
+
+	KernelTables* tables = createKernelTables();
+	RouteDistribution* distribution = (RouteDistribution*)malloc(sizeof(RouteDistribution));
+
+	if (traversalCount < 0 || tables == NULL || distribution == NULL) {
+		freeTraversalStore(&traversals);
+		freeKernelTables(tables);
+		free(distribution);
+		system("pause");
+		return;
+	}
+
+	int targetYear, targetMonth, targetDay, hour, minute, numSamples;
+
+	printf("Enter departure date (YYYY-MM-DD): \n");
+	scanf("%d-%d-%d", &targetYear, &targetMonth, &targetDay);
+	printf("Enter departure time of the day (HH:MM): \n");
+	scanf("%d:%d", &hour, &minute);
+	printf("Enter number of samples (e.g. 100000): \n");
+	if (scanf("%d", &numSamples) != 1 || numSamples <= 0) {
+		clearInputBuffer();
+		numSamples = 100000;
+	}
+
+	int departureTime = hour * 3600 + minute * 60;
+
+	ValidTraversal tempTraversal = { 0, 0, targetYear, targetMonth, targetDay, departureTime };
+	int targetDOW = getDayOfWeek(&tempTraversal);
+
+	buildKernelTables(tables, segments, NUM_SEGMENTS, &traversals, targetYear, targetMonth, targetDay, targetDOW, modelParams);
+
+	if (simulateRouteDistribution(tables, departureTime, numSamples, (unsigned long long)time(NULL), distribution) == 0) {
+		printf("Simulated %d routes in %.1f ms\n", distribution->numSamples, distribution->elapsedMs);
+		printf("Duration mean %.1f s, std dev %.1f s, p50 %.1f s, p90 %.1f s, p95 %.1f s\n",
+			distribution->mean, distribution->stddev, distribution->p50, distribution->p90, distribution->p95);
+
+		// Arrival-time histogram in one-minute rows between the 0.5th and 99.5th percentiles
+		int firstMinute = (int)(routeDistributionQuantile(distribution, 0.005) / 60);
+		int lastMinute = (int)(routeDistributionQuantile(distribution, 0.995) / 60);
+		int binsPerMinute = 60 / MC_HISTOGRAM_BIN_SECONDS;
+		long long largest = 1;
+
+		for (int m = firstMinute; m <= lastMinute; m++) {
+			long long count = 0;
+			for (int b = m * binsPerMinute; b < (m + 1) * binsPerMinute && b < MC_HISTOGRAM_BINS; b++) count += distribution->histogram[b];
+			if (count > largest) largest = count;
+		}
+
+		printf("Arrival | Share\n");
+		for (int m = firstMinute; m <= lastMinute; m++) {
+			long long count = 0;
+			for (int b = m * binsPerMinute; b < (m + 1) * binsPerMinute && b < MC_HISTOGRAM_BINS; b++) count += distribution->histogram[b];
+
+			int arrival = (departureTime / 60 + m) % 1440;
+			printf("  %02d:%02d | %5.1f%% ", arrival / 60, arrival % 60, 100.0 * count / distribution->numSamples);
+			for (int bar = 0; bar < (int)(50 * count / largest); bar++) printf("#");
+			printf("\n");
+		}
+		if (distribution->overflowCount > 0) {
+			printf("%lld samples exceeded the %d minute histogram range.\n", distribution->overflowCount, MC_HISTOGRAM_BINS * MC_HISTOGRAM_BIN_SECONDS / 60);
+		}
+	}
+
+	freeTraversalStore(&traversals);
+	freeKernelTables(tables);
+	free(distribution);
+
+	system("pause");
+}
+
+// Answer "when should I leave to arrive by HH:MM with N% confidence?"
+void planDeparture(char* traversalfilename, Segment* segments, ModelParams* modelParams) {
+	TraversalStore traversals;
+	initTraversalStore(&traversals);
+	int traversalCount = loadTraversals(traversalfilename, &traversals);
+
+	if (traversalCount < 0) {
+		freeTraversalStore(&traversals);
+		system("pause");
+		return;
+	}
+
+	int targetYear, targetMonth, targetDay, hour, minute;
+	double confidencePercent;
+
+	printf("Enter date (YYYY-MM-DD): \n");
+	scanf("%d-%d-%d", &targetYear, &targetMonth, &targetDay);
+	printf("Enter target arrival time (HH:MM): \n");
+	scanf("%d:%d", &hour, &minute);
+	printf("Enter confidence of arriving on time (%%, e.g. 95): \n");
+	scanf("%lf", &confidencePercent);
+
+	int targetArrival = hour * 3600 + minute * 60;
+
+	ValidTraversal tempTraversal = { 0, 0, targetYear, targetMonth, targetDay, targetArrival };
+	int targetDOW = getDayOfWeek(&tempTraversal);
+
+	DepartureResult result;
+	if (findLatestDeparture(segments, &traversals, targetArrival, confidencePercent / 100.0, targetYear, targetMonth, targetDay, targetDOW, modelParams, &result) == 0) {
+		if (result.found) {
+			printf("Leave by %02d:%02d to arrive by %02d:%02d with %.0f%% confidence.\n",
+				result.departureTime / 3600, (result.departureTime % 3600) / 60, hour, minute, confidencePercent);
+			printf("Predicted duration %.1f s (std dev %.1f s), %.0f%% arrival at %02d:%02d:%02d\n",
+				result.routeMean, result.routeStddev, confidencePercent,
+				(int)result.safeArrival / 3600, ((int)result.safeArrival % 3600) / 60, (int)result.safeArrival % 60);
+		}
+		else {
+			printf("No departure within %d hours before %02d:%02d arrives on time with %.0f%% confidence.\n",
+				PLANNER_SEARCH_WINDOW / 3600, hour, minute, confidencePercent);
+		}
+		printf("Model evaluations: %d (a minute-by-minute scan would use %d)\n", result.evaluations, result.candidates);
+	}
+
+	freeTraversalStore(&traversals);
+
+	system("pause");
+}
+
+// Measure forecast quality: each day's drives are predicted from a model built on the other days
+void backtestPredictions(char* traversalfilename, Segment* segments, ModelParams* modelParams) {
+	TraversalStore traversals;
+	initTraversalStore(&traversals);
+	int traversalCount = loadTraversals(traversalfilename, &traversals);
+
+	if (traversalCount < 0) {
+		freeTraversalStore(&traversals);
+		system("pause");
+		return;
+	}
+
+	BacktestSummary summary;
+	if (runBacktest(segments, NUM_SEGMENTS, &traversals, modelParams, &summary, stdout) == 0) {
+		printf("Backtested %d runs over %d days in %.1f ms (%d partial runs skipped)\n", summary.runs, summary.days, summary.elapsedMs, summary.skippedRuns);
+		printf("MAE: %.1f s, bias: %+.1f s, RMSE: %.1f s\n", summary.mae, summary.bias, summary.rmse);
+		printf("Std dev calibration: RMS z-score %.2f (1.00 ideal), within 1 sigma %.0f%% (68%% ideal), within 2 sigma %.0f%% (95%% ideal)\n",
+			summary.zRms, 100.0 * summary.within1Sigma, 100.0 * summary.within2Sigma);
+	}
+
+	freeTraversalStore(&traversals);
+
+	system("pause");
+}
+
+// Grid search of the weighting parameters against held-out traversals, optionally adopting the best set
+void tuneModel(char* traversalfilename, Segment* segments, ModelParams* modelParams) {
+	TraversalStore traversals;
+	initTraversalStore(&traversals);
+	int traversalCount = loadTraversals(traversalfilename, &traversals);
+
+	if (traversalCount < 0) {
+		freeTraversalStore(&traversals);
+		system("pause");
+		return;
+	}
+
+	TuningSummary summary;
+	if (tuneModelParams(segments, NUM_SEGMENTS, &traversals, &summary) == 0) {
+		printf("Scored %d parameter sets on %d held-out traversals (%lld pairs, cached in %d batch(es)) in %.1f ms\n", summary.gridSize, summary.queries, summary.pairs, summary.batches, summary.elapsedMs);
+		printf("Half-life | Time sigma | Same DOW | Adjacent | Day class |   MAE (s) |  Bias (s) |    NLL | RMS z\n");
+		for (int i = 0; i < summary.bestCount; i++) {
+			TuningResult* r = &summary.best[i];
+			printf("%7.0f d | %8.0f s | %8.2f | %8.2f | %9.2f | %9.2f | %+9.2f | %6.2f | %5.2f\n",
+				r->params.halfLifeDays, r->params.timeSigmaSeconds, r->params.sameDOWWeight, r->params.adjacentDOWWeight, r->params.dayClassWeight,
+				r->mae, r->bias, r->nll, r->zRms);
+		}
+		if (summary.hasDefault) {
+			printf("Defaults: MAE %.2f s, bias %+.2f s, NLL %.2f, RMS z %.2f\n", summary.defaultResult.mae, summary.defaultResult.bias, summary.defaultResult.nll, summary.defaultResult.zRms);
+		}
+
+		if (summary.bestCount > 0) {
+			char answer = 'n';
+			printf("Use the best parameter set for this session? (y/n): \n");
+			scanf(" %c", &answer);
+			if (answer == 'y' || answer == 'Y') {
+				*modelParams = summary.best[0].params;
+				printf("Model parameters updated.\n");
+			}
+		}
+		else {
+			printf("Not enough traversals on different days to tune the model.\n");
+		}
+	}
+
+	freeTraversalStore(&traversals);
+
+	system("pause");
+}
+
+// Write the pre-aggregated tables visualize_segments.py loads instead of the raw text outputs
+void exportDashboardTables(char* traversalfilename, Segment* segments) {
+	TraversalStore traversals;
+	initTraversalStore(&traversals);
+	int traversalCount = loadTraversals(traversalfilename, &traversals);
+
+	SegmentHeatmap* heatmap = (SegmentHeatmap*)malloc(sizeof(SegmentHeatmap));
+
+	if (traversalCount < 0 || heatmap == NULL) {
+		freeTraversalStore(&traversals);
+		free(heatmap);
+		system("pause");
+		return;
+	}
+
+	if (buildSegmentHeatmap(segments, NUM_SEGMENTS, &traversals, heatmap) == 0 && writeSegmentHeatmap(heatmap, HEATMAP_FILENAME) == 0) {
+		printf("Segment heatmap: %d traversals summarized into %d x %d cells in %.2f ms, saved to '%s'.\n",
+			heatmap->traversals, heatmap->numSegments, HOURS_PER_WEEK, heatmap->elapsedMs, HEATMAP_FILENAME);
+	}
+
+	int vertices = writeRoutePolyline(routeCorridors, NUM_ROUTE_CORRIDORS, ROUTE_POLYLINE_FILENAME);
+	if (vertices >= 0) {
+		printf("Route polyline: %d vertices saved to '%s'.\n", vertices, ROUTE_POLYLINE_FILENAME);
+	}
+
+	freeTraversalStore(&traversals);
+	free(heatmap);
+
+	system("pause");
+}
+
+// Replay one recorded drive segment by segment, as the live trip state would see it. The model
+// (kernel tables and segment correlations) is built from the other days only, and after each
+// segment exit the remaining-time forecast is compared with and without cross-segment correlations.
+void replayTrip(char* traversalfilename, Segment* segments, ModelParams* modelParams) {
+	TraversalStore traversals;
+	TraversalStore history;
+	initTraversalStore(&traversals);
+	initTraversalStore(&history);
+	int traversalCount = loadTraversals(traversalfilename, &traversals);
+
+	KernelTables* tables = createKernelTables();
+	SegmentCorrelations* correlations = (SegmentCorrelations*)malloc(sizeof(SegmentCorrelations));
+
+	if (traversalCount < 0 || tables == NULL || correlations == NULL) {
+		freeTraversalStore(&traversals);
+		freeKernelTables(tables);
+		free(correlations);
+		system("pause");
+		return;
+	}
+
+	int targetYear, targetMonth, targetDay;
+	printf("Enter date of the drive to replay (YYYY-MM-DD): \n");
+	scanf("%d-%d-%d", &targetYear, &targetMonth, &targetDay);
+
+	// Split the traversals into the replayed day's first drive and the history of the other days
+	int drive[NUM_SEGMENTS];
+	int driveLength = 0;
+	int startSegment = -1;
+	int driveClosed = 0;
+	for (int i = 0; i < traversals.count; i++) {
+		ValidTraversal* t = traversalAt(&traversals, i);
+		if (t->year != targetYear || t->month != targetMonth || t->day != targetDay) {
+			ValidTraversal* slot = appendTraversal(&history);
+			if (slot == NULL) break;
+			*slot = *t;
+			continue;
+		}
+
+		int segmentIndex = -1;
+		for (int j = 0; j < NUM_SEGMENTS; j++) {
+			if (segments[j].segment_id == t->segment_id) segmentIndex = j;
+		}
+		if (segmentIndex < 0) continue;
+
+		if (driveLength == 0) {
+			startSegment = segmentIndex;
+			drive[driveLength++] = i;
+		}
+		else if (!driveClosed && segmentIndex == startSegment + driveLength) {
+			drive[driveLength++] = i;
+		}
+		else {
+			driveClosed = 1; // Later drives of the same day are left out of both sets
+		}
+	}
+
+	if (driveLength < 2 || history.count == 0) {
+		printf("No drive of at least two segments on %04d-%02d-%02d, or no other days to learn from.\n", targetYear, targetMonth, targetDay);
+		freeTraversalStore(&traversals);
+		freeTraversalStore(&history);
+		freeKernelTables(tables);
+		free(correlations);
+		system("pause");
+		return;
+	}
+
+	ValidTraversal tempTraversal = { 0, 0, targetYear, targetMonth, targetDay, 0 };
+	int targetDOW = getDayOfWeek(&tempTraversal);
+	buildKernelTables(tables, segments, NUM_SEGMENTS, &history, targetYear, targetMonth, targetDay, targetDOW, modelParams);
+
+	if (learnSegmentCorrelations(segments, NUM_SEGMENTS, &history, tables, correlations) == 0) {
+		printf("Segment factor loadings learned from %d drives on other days:\n", correlations->drives);
+		for (int s = 0; s < NUM_SEGMENTS; s++) {
+			printf("  Segment %2d: %+.2f\n", segments[s].segment_id, correlations->loading[s]);
+		}
+
+		int departure = traversalAt(&traversals, drive[0])->startTime;
+		int reachesEnd = (startSegment + driveLength == NUM_SEGMENTS);
+		double observedTotal = 0.0;
+		for (int k = 0; k < driveLength; k++) observedTotal += traversalAt(&traversals, drive[k])->duration;
+
+		TripState trip;
+		startTrip(&trip, correlations, tables, startSegment, departure);
+
+		printf("Replaying %d segments from %02d:%02d:%02d%s\n", driveLength, departure / 3600, (departure % 3600) / 60, departure % 60,
+			reachesEnd ? "" : " (drive does not reach the last segment, actual remaining time is not available)");
+		printf("Segment | Observed |  Factor | Remaining: correlated     | independent       | actual\n");
+
+		double correlatedError = 0.0, independentError = 0.0;
+		int scored = 0;
+		for (int k = 0; k <= driveLength; k++) {
+			TripForecast correlated, independent;
+			forecastTrip(&trip, 1, &correlated);
+			forecastTrip(&trip, 0, &independent);
+
+			double actualRemaining = observedTotal - trip.elapsed;
+			if (k == 0) printf("  start |          |");
+			else printf("%7d | %6d s |", segments[startSegment + k - 1].segment_id, traversalAt(&traversals, drive[k - 1])->duration);
+			printf(" %+6.2f  | %7.1f +/- %5.1f s | %7.1f +/- %5.1f s",
+				correlated.factorMean, correlated.remainingMean, correlated.remainingStddev, independent.remainingMean, independent.remainingStddev);
+
+			if (reachesEnd && k < driveLength) {
+				printf(" | %7.1f s\n", actualRemaining);
+				correlatedError += fabs(correlated.remainingMean - actualRemaining);
+				independentError += fabs(independent.remainingMean - actualRemaining);
+				scored++;
+			}
+			else {
+				printf(" |\n");
+			}
+
+			if (k < driveLength) {
+				ValidTraversal* t = traversalAt(&traversals, drive[k]);
+				tripSegmentCompleted(&trip, t->startTime, (double)t->duration);
+			}
+		}
+
+		if (scored > 0) {
+			printf("Mean absolute error of the remaining-time forecast: correlated %.1f s, independent %.1f s\n",
+				correlatedError / scored, independentError / scored);
+		}
+	}
+
+	freeTraversalStore(&traversals);
+	freeTraversalStore(&history);
+	freeKernelTables(tables);
+	free(correlations);
+
+	system("pause");
+}
+
+// Replay the bundled GPS log and compare against the committed outputs and stage time baseline
+void checkRegressions(Segment* segments) {
+	RegressionReport report;
+	printf("Running regression check (%d timed runs per stage)...\n", REGRESSION_TIMING_RUNS);
+	if (runRegressionCheck(segments, NUM_SEGMENTS, 0, &report) >= 0) {
+		printRegressionReport(&report, stdout);
+	}
 
 	system("pause");
 }
 
-void printMenu() {
+void printMenu(int usePrecomputedTables, int useCorridors) {
 	printf("{ Traffic Forecasting ESP Data Processor }\n");
 	printf("1. Select ESP Data File\n");
 	printf("2. Select Output Traversal File\n");
@@ -365,7 +1080,18 @@ void printMenu() {
 	printf("4. Process ESP Data\n");
 	printf("5. Generate predictions for a specific time (command line readout)\n");
 	printf("6. Generate prediction set (file readout)\n");
-	printf("7. Exit\n");
+	printf("7. Convert ESP data file to compressed archive\n");
+	printf("8. Toggle precomputed kernel tables for prediction sets (currently: %s)\n", usePrecomputedTables ? "ON" : "OFF");
+	printf("9. Segment duration quantiles for a time of day (p50/p90/p95)\n");
+	printf("10. Monte Carlo arrival-time distribution for a departure time\n");
+	printf("11. Find latest departure for a target arrival time\n");
+	printf("12. Backtest predictions (leave-one-day-out)\n");
+	printf("13. Tune model parameters (grid search)\n");
+	printf("14. Toggle corridor map-matching for processing (currently: %s)\n", useCorridors ? "ON" : "OFF");
+	printf("15. Export dashboard tables (segment heatmap, route polyline)\n");
+	printf("16. Replay a recorded drive with live trip updates\n");
+	printf("17. Run regression check against the committed outputs\n");
+	printf("18. Exit\n");
 	printf("-------------------------------\n");
 }
 
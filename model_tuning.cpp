@@ -0,0 +1,379 @@
+#include "model_tuning.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <string.h>
+
+// Parameter grid. The defaults from prediction.h are included so the current model is always scored.
+static const double halfLifeGrid[] = { 7.0, 14.0, 30.0, 60.0, 120.0, 365.0 };
+static const double timeSigmaGrid[] = { 600.0, 900.0, 1200.0, 1800.0, 2700.0, 3600.0 };
+static const double sameDOWGrid[] = { 1.0, 1.5, 2.0, 3.0 };
+static const double adjacentDOWGrid[] = { 1.0, 1.2, 1.5 };
+static const double dayClassGrid[] = { 1.0, 1.2, 1.5 };
+
+#define GRID_LENGTH(grid) ((int)(sizeof(grid) / sizeof(grid[0])))
+#define DOW_CLASSES 6 // Same / adjacent / other day of week, times whether the weekday-weekend class matches
+#define DOW_COMBOS (GRID_LENGTH(sameDOWGrid) * GRID_LENGTH(adjacentDOWGrid) * GRID_LENGTH(dayClassGrid))
+
+// Candidate history traversal, sorted by segment and then day so the traversals a query may be
+// predicted from are its segment's range minus one contiguous same-day run
+typedef struct {
+	int segmentIndex;
+	int dayIndex;
+	int traversal;
+} TuningCandidate;
+
+// Parameter-independent parts of every (query, traversal) weight for the current batch of
+// queries, stored column-wise. Pairs of query q are [pairOffsets[q], pairOffsets[q + 1]), offset
+// by pairBase in the cache.
+typedef struct {
+	int firstQuery;            // Batch is queries [firstQuery, lastQuery)
+	int lastQuery;
+	double* observed;          // Observed duration of each held-out traversal
+	long long* pairOffsets;
+	long long pairBase;
+
+	unsigned short* timeDiffs; // Time-of-day difference in seconds, wrapped around midnight (<= 43200)
+	unsigned short* dateDiffs; // Days between the traversals
+	unsigned char* dowClasses; // Index into the DOW_CLASSES multipliers
+	float* durations;          // Duration of the history traversal
+
+	TuningResult* results;     // One entry per grid point; error sums until every batch is scored
+} TuningContext;
+
+static int compareCandidates(const void* a, const void* b) {
+	const TuningCandidate* ca = (const TuningCandidate*)a;
+	const TuningCandidate* cb = (const TuningCandidate*)b;
+	if (ca->segmentIndex != cb->segmentIndex) return (ca->segmentIndex > cb->segmentIndex) - (ca->segmentIndex < cb->segmentIndex);
+	if (ca->dayIndex != cb->dayIndex) return (ca->dayIndex > cb->dayIndex) - (ca->dayIndex < cb->dayIndex);
+	return (ca->traversal > cb->traversal) - (ca->traversal < cb->traversal);
+}
+
+// First candidate in [low, high) whose day is not before dayIndex
+static int firstCandidateOnDay(TuningCandidate* candidates, int low, int high, int dayIndex) {
+	while (low < high) {
+		int mid = low + (high - low) / 2;
+		if (candidates[mid].dayIndex < dayIndex) low = mid + 1;
+		else high = mid;
+	}
+	return low;
+}
+
+// Same day-of-week classification as dayOfWeekWeight, without the multipliers
+static int dowClass(int dow, int targetDOW) {
+	int dowDiff = abs(dow - targetDOW);
+	int level = (dowDiff == 0) ? 0 : (dowDiff == 1) ? 1 : 2;
+
+	int sameClass = (dow > 1 && dow < 6 && targetDOW > 1 && targetDOW < 6) ||
+		((dow == 0 || dow == 6) && (targetDOW == 0 || targetDOW == 6));
+
+	return level * 2 + sameClass;
+}
+
+// Fill in the parameters of every grid point and clear its error sums
+static void initGridResults(TuningResult* results) {
+	int g = 0;
+	for (int h = 0; h < GRID_LENGTH(halfLifeGrid); h++) {
+		for (int t = 0; t < GRID_LENGTH(timeSigmaGrid); t++) {
+			for (int a = 0; a < GRID_LENGTH(sameDOWGrid); a++) {
+				for (int b = 0; b < GRID_LENGTH(adjacentDOWGrid); b++) {
+					for (int c = 0; c < GRID_LENGTH(dayClassGrid); c++) {
+						memset(&results[g], 0, sizeof(TuningResult));
+						results[g].params.halfLifeDays = halfLifeGrid[h];
+						results[g].params.timeSigmaSeconds = timeSigmaGrid[t];
+						results[g].params.sameDOWWeight = sameDOWGrid[a];
+						results[g].params.adjacentDOWWeight = adjacentDOWGrid[b];
+						results[g].params.dayClassWeight = dayClassGrid[c];
+						g++;
+					}
+				}
+			}
+		}
+	}
+}
+
+// Score the current batch of queries for every day-of-week combination of one (half-life, time
+// sigma) pair, adding to the error sums in the results. The kernel weight of each pair is computed
+// once and accumulated per day-of-week class; the DOW_COMBOS multiplier settings then only
+// re-weight DOW_CLASSES partial sums per query.
+static void evaluateKernelSetting(int task, void* context) {
+	TuningContext* ctx = (TuningContext*)context;
+
+	double halfLife = halfLifeGrid[task / GRID_LENGTH(timeSigmaGrid)];
+	double sigma = timeSigmaGrid[task % GRID_LENGTH(timeSigmaGrid)];
+	double timeScale = -0.5 / (sigma * sigma);
+	double dateScale = -log(2.0) / halfLife;
+	double minDateExponent = log(1e-6); // Same floor as dateDecayFromDays
+
+	double multipliers[DOW_COMBOS][DOW_CLASSES];
+	double absError[DOW_COMBOS] = { 0 };
+	double sumError[DOW_COMBOS] = { 0 };
+	double sumNll[DOW_COMBOS] = { 0 };
+	double sumZSquares[DOW_COMBOS] = { 0 };
+
+	TuningResult* results = &ctx->results[task * DOW_COMBOS];
+
+	int combo = 0;
+	for (int a = 0; a < GRID_LENGTH(sameDOWGrid); a++) {
+		for (int b = 0; b < GRID_LENGTH(adjacentDOWGrid); b++) {
+			for (int c = 0; c < GRID_LENGTH(dayClassGrid); c++) {
+				double levels[3] = { sameDOWGrid[a], adjacentDOWGrid[b], 1.0 };
+				for (int k = 0; k < DOW_CLASSES; k++) {
+					multipliers[combo][k] = levels[k / 2] * ((k % 2) ? dayClassGrid[c] : 1.0);
+				}
+				combo++;
+			}
+		}
+	}
+
+	for (int q = ctx->firstQuery; q < ctx->lastQuery; q++) {
+		double sums[DOW_CLASSES][3] = { { 0 } }; // Weighted sums of 1, duration and duration^2 per class
+
+		for (long long p = ctx->pairOffsets[q] - ctx->pairBase; p < ctx->pairOffsets[q + 1] - ctx->pairBase; p++) {
+			double timeDiff = ctx->timeDiffs[p];
+			double dateExponent = dateScale * ctx->dateDiffs[p];
+			if (dateExponent < minDateExponent) dateExponent = minDateExponent;
+
+			double w = exp(timeScale * timeDiff * timeDiff + dateExponent);
+			double d = ctx->durations[p];
+			double* s = sums[ctx->dowClasses[p]];
+			s[0] += w;
+			s[1] += w * d;
+			s[2] += w * d * d;
+		}
+
+		for (int k = 0; k < DOW_COMBOS; k++) {
+			double sumWeights = 0.0, sumDurations = 0.0, sumSquares = 0.0;
+			for (int c = 0; c < DOW_CLASSES; c++) {
+				sumWeights += multipliers[k][c] * sums[c][0];
+				sumDurations += multipliers[k][c] * sums[c][1];
+				sumSquares += multipliers[k][c] * sums[c][2];
+			}
+
+			// Same convention as weightedMeanAndStd when every weight underflows
+			double mean = 0.0, variance = 0.0;
+			if (sumWeights > 0.0) {
+				mean = sumDurations / sumWeights;
+				variance = sumSquares / sumWeights - mean * mean;
+				if (variance < 0.0) variance = 0.0;
+			}
+
+			double stddev = sqrt(variance);
+			if (stddev < TUNING_MIN_STDDEV) stddev = TUNING_MIN_STDDEV;
+
+			double error = mean - ctx->observed[q];
+			double z = error / stddev;
+			absError[k] += fabs(error);
+			sumError[k] += error;
+			sumNll[k] += log(stddev) + 0.5 * log(2.0 * PI) + 0.5 * z * z;
+			sumZSquares[k] += z * z;
+		}
+	}
+
+	for (int k = 0; k < DOW_COMBOS; k++) {
+		results[k].mae += absError[k];
+		results[k].bias += sumError[k];
+		results[k].nll += sumNll[k];
+		results[k].zRms += sumZSquares[k];
+	}
+}
+
+static void freeTuningContext(TuningContext* ctx) {
+	free(ctx->observed);
+	free(ctx->pairOffsets);
+	free(ctx->timeDiffs);
+	free(ctx->dateDiffs);
+	free(ctx->dowClasses);
+	free(ctx->durations);
+	free(ctx->results);
+}
+
+// Grid search over ModelParams. Each held-out traversal is predicted at its own start time from the
+// traversals of the same segment on other days (leave-one-day-out), and parameter sets are ranked by
+// the mean absolute error of those segment predictions. Time differences, day gaps and day-of-week
+// classes of every (query, traversal) pair are computed once and shared by all grid points. The history
+// is bucketed by segment and day up front, so each query only visits its own segment's traversals, and
+// the pairs are cached and scored in batches of queries of at most TUNING_MAX_CACHED_PAIRS pairs.
+// Returns 0 on success, -1 on failure.
+int tuneModelParams(Segment* segments, int numSegments, TraversalStore* traversals, TuningSummary* summary) {
+	auto start = std::chrono::steady_clock::now();
+	int traversalCount = traversals->count;
+
+	memset(summary, 0, sizeof(TuningSummary));
+
+	TuningContext ctx;
+	memset(&ctx, 0, sizeof(ctx));
+
+	int n = (traversalCount > 0) ? traversalCount : 1;
+	int gridSize = GRID_LENGTH(halfLifeGrid) * GRID_LENGTH(timeSigmaGrid) * DOW_COMBOS;
+	TraversalFeatures* features = (TraversalFeatures*)malloc(n * sizeof(TraversalFeatures));
+	TuningCandidate* candidates = (TuningCandidate*)malloc(n * sizeof(TuningCandidate));
+	int* segmentOffsets = (int*)calloc(numSegments + 1, sizeof(int));
+	int* queries = (int*)malloc(TUNING_MAX_QUERIES * sizeof(int));
+	int* queryRanges = (int*)malloc(2 * TUNING_MAX_QUERIES * sizeof(int)); // Same-day candidate range of each query
+	ctx.observed = (double*)malloc(TUNING_MAX_QUERIES * sizeof(double));
+	ctx.pairOffsets = (long long*)malloc((TUNING_MAX_QUERIES + 1) * sizeof(long long));
+	ctx.results = (TuningResult*)malloc(gridSize * sizeof(TuningResult));
+
+	if (!features || !candidates || !segmentOffsets || !queries || !queryRanges || !ctx.observed || !ctx.pairOffsets || !ctx.results) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		free(features);
+		free(candidates);
+		free(segmentOffsets);
+		free(queries);
+		free(queryRanges);
+		freeTuningContext(&ctx);
+		return -1;
+	}
+
+	computeTraversalFeatures(segments, numSegments, traversals, features);
+
+	// Bucket the history by segment, then by day within each segment
+	int candidateCount = 0;
+	for (int i = 0; i < traversalCount; i++) {
+		if (features[i].segmentIndex < 0) continue;
+		candidates[candidateCount].segmentIndex = features[i].segmentIndex;
+		candidates[candidateCount].dayIndex = features[i].dayIndex;
+		candidates[candidateCount].traversal = i;
+		candidateCount++;
+		segmentOffsets[features[i].segmentIndex + 1]++;
+	}
+	qsort(candidates, candidateCount, sizeof(TuningCandidate), compareCandidates);
+	for (int s = 0; s < numSegments; s++) segmentOffsets[s + 1] += segmentOffsets[s];
+
+	// Pick held-out traversals evenly across the history and count their pairs
+	int stride = (traversalCount + TUNING_MAX_QUERIES - 1) / TUNING_MAX_QUERIES;
+	if (stride < 1) stride = 1;
+
+	int queryCount = 0;
+	long long pairCount = 0;
+	long long largestQuery = 0;
+	ctx.pairOffsets[0] = 0;
+	for (int i = 0; i < traversalCount && queryCount < TUNING_MAX_QUERIES; i += stride) {
+		int segment = features[i].segmentIndex;
+		if (segment < 0) continue;
+
+		int segmentStart = segmentOffsets[segment];
+		int segmentEnd = segmentOffsets[segment + 1];
+		int dayStart = firstCandidateOnDay(candidates, segmentStart, segmentEnd, features[i].dayIndex);
+		int dayEnd = firstCandidateOnDay(candidates, dayStart, segmentEnd, features[i].dayIndex + 1);
+
+		long long pairs = (segmentEnd - segmentStart) - (dayEnd - dayStart);
+		if (pairs == 0) continue; // Nothing to predict from
+
+		queries[queryCount] = i;
+		queryRanges[2 * queryCount] = dayStart;
+		queryRanges[2 * queryCount + 1] = dayEnd;
+		ctx.observed[queryCount] = features[i].duration;
+		pairCount += pairs;
+		if (pairs > largestQuery) largestQuery = pairs;
+		queryCount++;
+		ctx.pairOffsets[queryCount] = pairCount;
+	}
+
+	// The cache holds one batch of queries; a single query larger than the bound still gets a batch of its own
+	long long cacheSize = (pairCount < TUNING_MAX_CACHED_PAIRS) ? pairCount : TUNING_MAX_CACHED_PAIRS;
+	if (cacheSize < largestQuery) cacheSize = largestQuery;
+	if (cacheSize < 1) cacheSize = 1;
+	ctx.timeDiffs = (unsigned short*)malloc(cacheSize * sizeof(unsigned short));
+	ctx.dateDiffs = (unsigned short*)malloc(cacheSize * sizeof(unsigned short));
+	ctx.dowClasses = (unsigned char*)malloc(cacheSize * sizeof(unsigned char));
+	ctx.durations = (float*)malloc(cacheSize * sizeof(float));
+
+	if (!ctx.timeDiffs || !ctx.dateDiffs || !ctx.dowClasses || !ctx.durations) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		free(features);
+		free(candidates);
+		free(segmentOffsets);
+		free(queries);
+		free(queryRanges);
+		freeTuningContext(&ctx);
+		return -1;
+	}
+
+	initGridResults(ctx.results);
+
+	for (int first = 0; first < queryCount;) {
+		// Extend the batch while its pairs fit in the cache
+		int last = first + 1;
+		while (last < queryCount && ctx.pairOffsets[last + 1] - ctx.pairOffsets[first] <= cacheSize) last++;
+
+		ctx.firstQuery = first;
+		ctx.lastQuery = last;
+		ctx.pairBase = ctx.pairOffsets[first];
+
+		// Fill the pair cache from each query's segment bucket, skipping its own day
+		for (int q = first; q < last; q++) {
+			TraversalFeatures* query = &features[queries[q]];
+			int segmentStart = segmentOffsets[query->segmentIndex];
+			int segmentEnd = segmentOffsets[query->segmentIndex + 1];
+			long long k = ctx.pairOffsets[q] - ctx.pairBase;
+
+			for (int c = segmentStart; c < segmentEnd; c++) {
+				if (c == queryRanges[2 * q]) c = queryRanges[2 * q + 1]; // Jump over the query's day
+				if (c >= segmentEnd) break;
+
+				TraversalFeatures* f = &features[candidates[c].traversal];
+				int diff = abs(f->startTime - query->startTime);
+				int dateDiff = abs(query->dayIndex - f->dayIndex);
+
+				ctx.timeDiffs[k] = (unsigned short)((diff > 43200) ? (86400 - diff) : diff);
+				ctx.dateDiffs[k] = (unsigned short)((dateDiff > 65535) ? 65535 : dateDiff);
+				ctx.dowClasses[k] = (unsigned char)dowClass(f->dow, query->dow);
+				ctx.durations[k] = (float)f->duration;
+				k++;
+			}
+		}
+
+		parallelFor(GRID_LENGTH(halfLifeGrid) * GRID_LENGTH(timeSigmaGrid), evaluateKernelSetting, &ctx);
+		summary->batches++;
+		first = last;
+	}
+	free(features);
+	free(candidates);
+	free(segmentOffsets);
+	free(queries);
+	free(queryRanges);
+
+	// Turn the error sums into means over the queries
+	for (int g = 0; g < gridSize; g++) {
+		TuningResult* r = &ctx.results[g];
+		int count = (queryCount > 0) ? queryCount : 1;
+		r->mae /= count;
+		r->bias /= count;
+		r->nll /= count;
+		r->zRms = sqrt(r->zRms / count);
+	}
+
+	// Keep the TUNING_TOP_RESULTS lowest-MAE parameter sets, and the score of the current defaults
+	ModelParams defaults = defaultModelParams();
+	for (int g = 0; g < gridSize; g++) {
+		TuningResult* r = &ctx.results[g];
+
+		if (r->params.halfLifeDays == defaults.halfLifeDays && r->params.timeSigmaSeconds == defaults.timeSigmaSeconds &&
+			r->params.sameDOWWeight == defaults.sameDOWWeight && r->params.adjacentDOWWeight == defaults.adjacentDOWWeight &&
+			r->params.dayClassWeight == defaults.dayClassWeight) {
+			summary->defaultResult = *r;
+			summary->hasDefault = 1;
+		}
+
+		int pos = summary->bestCount;
+		while (pos > 0 && summary->best[pos - 1].mae > r->mae) pos--;
+		if (pos >= TUNING_TOP_RESULTS) continue;
+
+		int last = (summary->bestCount < TUNING_TOP_RESULTS) ? summary->bestCount : TUNING_TOP_RESULTS - 1;
+		for (int k = last; k > pos; k--) summary->best[k] = summary->best[k - 1];
+		summary->best[pos] = *r;
+		if (summary->bestCount < TUNING_TOP_RESULTS) summary->bestCount++;
+	}
+
+	summary->gridSize = gridSize;
+	summary->queries = queryCount;
+	summary->pairs = pairCount;
+	if (queryCount == 0) summary->bestCount = 0; // No held-out traversal had any history to predict from
+
+	freeTuningContext(&ctx);
+
+	summary->elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return 0;
+}
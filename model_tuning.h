@@ -0,0 +1,35 @@
+#ifndef MODEL_TUNING_H
+#define MODEL_TUNING_H
+
+#include "esp_data.h"
+#include "prediction.h"
+
+#define TUNING_MAX_QUERIES 2000 // Held-out traversals scored per grid point, sampled evenly from the history
+#define TUNING_MAX_CACHED_PAIRS (1 << 22) // Pair cache bound (~38 MB); larger workloads are scored in batches of queries
+#define TUNING_TOP_RESULTS 5
+#define TUNING_MIN_STDDEV 1.0   // Floor on the predicted std dev when scoring likelihood and calibration
+
+// Score of one parameter set on the held-out traversals
+typedef struct {
+	ModelParams params;
+	double mae;       // Mean absolute error in seconds (the objective)
+	double bias;      // Mean of predicted - observed in seconds
+	double nll;       // Mean Gaussian negative log-likelihood
+	double zRms;      // RMS z-score, close to 1 when the stddev is calibrated
+} TuningResult;
+
+typedef struct {
+	int gridSize;                          // Parameter sets evaluated
+	int queries;                           // Held-out traversals scored per parameter set
+	long long pairs;                       // (query, traversal) pairs scored per parameter set
+	int batches;                           // Query batches the pairs were cached and scored in
+	int hasDefault;                        // 1 if defaultModelParams() is on the grid
+	TuningResult defaultResult;
+	TuningResult best[TUNING_TOP_RESULTS]; // Lowest MAE first
+	int bestCount;
+	double elapsedMs;
+} TuningSummary;
+
+int tuneModelParams(Segment* segments, int numSegments, TraversalStore* traversals, TuningSummary* summary);
+
+#endif // model_tuning_h
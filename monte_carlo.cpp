@@ -0,0 +1,285 @@
+#include "monte_carlo.h"
+#include "parallel.h"
+
+#include <chrono>
+#include <stdint.h>
+#include <string.h>
+
+// Table steps to read for each segment, resolved once per simulation. Steps without data point at the
+// nearest step that has some, so samples near an empty step still see that segment's durations.
+typedef struct {
+	KernelTables* tables;
+	int nearestStep[NUM_SEGMENTS][KERNEL_TABLE_STEPS]; // The step itself if it has data, -1 if the segment has none
+} StepLookup;
+
+typedef struct {
+	StepLookup* lookup;
+	int departureTime;
+	int numSamples;
+	int numBatches;
+	unsigned long long seed;
+
+	// Per-batch results, merged after all batches finish
+	long long* histograms;
+	long long* overflowCounts;
+	double* sums;
+	double* sumSquares;
+} SimulationContext;
+
+static uint64_t splitmix64(uint64_t* state) {
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t rotateLeft(uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+// xoshiro256+ state for MC_LANES independent streams, stored lane-major so every step below
+// is the same operation across all lanes and compiles to vector instructions
+typedef struct {
+	uint64_t s0[MC_LANES];
+	uint64_t s1[MC_LANES];
+	uint64_t s2[MC_LANES];
+	uint64_t s3[MC_LANES];
+} LaneRandom;
+
+static void seedLaneRandom(LaneRandom* rng, unsigned long long seed, int batch) {
+	uint64_t state = seed ^ ((uint64_t)batch * 0xD1B54A32D192ED03ULL);
+	for (int lane = 0; lane < MC_LANES; lane++) {
+		rng->s0[lane] = splitmix64(&state);
+		rng->s1[lane] = splitmix64(&state);
+		rng->s2[lane] = splitmix64(&state);
+		rng->s3[lane] = splitmix64(&state);
+	}
+}
+
+// Uniform doubles in (0, 1] for every lane
+static void nextUniforms(LaneRandom* rng, double* out) {
+	for (int lane = 0; lane < MC_LANES; lane++) {
+		uint64_t result = rng->s0[lane] + rng->s3[lane];
+		uint64_t t = rng->s1[lane] << 17;
+
+		rng->s2[lane] ^= rng->s0[lane];
+		rng->s3[lane] ^= rng->s1[lane];
+		rng->s1[lane] ^= rng->s2[lane];
+		rng->s0[lane] ^= rng->s3[lane];
+		rng->s2[lane] ^= t;
+		rng->s3[lane] = rotateLeft(rng->s3[lane], 45);
+
+		out[lane] = ((result >> 11) + 1) * (1.0 / 9007199254740992.0);
+	}
+}
+
+// Standard normal draws for every lane. Box-Muller turns each pair of uniforms into two normals,
+// so one set of MC_LANES uniforms covers all lanes: lanes i and i + MC_LANES / 2 share a pair.
+static void nextNormals(LaneRandom* rng, double* out) {
+	double u[MC_LANES];
+	nextUniforms(rng, u);
+
+	for (int lane = 0; lane < MC_LANES / 2; lane++) {
+		double radius = sqrt(-2.0 * log(u[lane]));
+		double angle = 2.0 * PI * u[lane + MC_LANES / 2];
+		out[lane] = radius * cos(angle);
+		out[lane + MC_LANES / 2] = radius * sin(angle);
+	}
+}
+
+// Nearest step (circular distance) with a positive kernel weight for every step of one segment
+static void findNearestSteps(const double* sumWeights, int* nearest) {
+	int distance[KERNEL_TABLE_STEPS];
+
+	// Walk forward twice around the day remembering the last populated step, then backward for the next one
+	int previous = -1;
+	for (int j = 0; j < 2 * KERNEL_TABLE_STEPS; j++) {
+		int m = j % KERNEL_TABLE_STEPS;
+		if (sumWeights[m] > 0.0) previous = j;
+		if (j < KERNEL_TABLE_STEPS) continue;
+		nearest[m] = (previous < 0) ? -1 : previous % KERNEL_TABLE_STEPS;
+		distance[m] = j - previous;
+	}
+	if (previous < 0) return; // No data for this segment at all
+
+	int next = -1;
+	for (int j = 2 * KERNEL_TABLE_STEPS - 1; j >= 0; j--) {
+		int m = j % KERNEL_TABLE_STEPS;
+		if (sumWeights[m] > 0.0) next = j;
+		if (j >= KERNEL_TABLE_STEPS || next < 0) continue;
+		if (next - j < distance[m]) {
+			nearest[m] = next % KERNEL_TABLE_STEPS;
+			distance[m] = next - j;
+		}
+	}
+}
+
+static void buildStepLookup(KernelTables* tables, StepLookup* lookup) {
+	lookup->tables = tables;
+	for (int i = 0; i < tables->numSegments; i++) {
+		findNearestSteps(tables->sumWeights[i], lookup->nearestStep[i]);
+	}
+}
+
+// Simulate one batch of routes, MC_LANES at a time. Each segment's duration is drawn from the
+// distribution at that sample's own simulated arrival time at the segment.
+static void simulateBatch(int batch, void* context) {
+	SimulationContext* ctx = (SimulationContext*)context;
+	StepLookup* lookup = ctx->lookup;
+	KernelTables* tables = lookup->tables;
+
+	long long* histogram = ctx->histograms + (long long)batch * MC_HISTOGRAM_BINS;
+	long long overflow = 0;
+	double sum = 0.0;
+	double sumSquares = 0.0;
+
+	int batchStart = batch * MC_BATCH_SAMPLES;
+	int batchSamples = ctx->numSamples - batchStart;
+	if (batchSamples > MC_BATCH_SAMPLES) batchSamples = MC_BATCH_SAMPLES;
+
+	LaneRandom rng;
+	seedLaneRandom(&rng, ctx->seed, batch);
+
+	for (int base = 0; base < batchSamples; base += MC_LANES) {
+		double currentTime[MC_LANES];
+		double total[MC_LANES];
+		double z[MC_LANES];
+
+		for (int lane = 0; lane < MC_LANES; lane++) {
+			currentTime[lane] = ctx->departureTime;
+			total[lane] = 0.0;
+		}
+
+		for (int i = 0; i < tables->numSegments; i++) {
+			nextNormals(&rng, z);
+
+			const int* nearestStep = lookup->nearestStep[i];
+			const double* sumWeights = tables->sumWeights[i];
+			const double* sumDurations = tables->sumDurations[i];
+			const double* sumSquares = tables->sumSquares[i];
+
+			for (int lane = 0; lane < MC_LANES; lane++) {
+				double position = currentTime[lane] / KERNEL_STEP_SECONDS;
+				int step = (int)position;
+				double fraction = position - step;
+				int nextStep = (step + 1 == KERNEL_TABLE_STEPS) ? 0 : step + 1;
+
+				// Interpolate the weighted sums like lookupSegmentDuration, then match a lognormal
+				// to the resulting mean and variance (durations are positive and right-skewed)
+				int a = nearestStep[step];
+				int b = nearestStep[nextStep];
+				double duration = 0.0; // Segments without data contribute nothing, as in the analytic path
+				if (a >= 0) {
+					double w = sumWeights[a] + fraction * (sumWeights[b] - sumWeights[a]);
+					double mean = (sumDurations[a] + fraction * (sumDurations[b] - sumDurations[a])) / w;
+					double variance = (sumSquares[a] + fraction * (sumSquares[b] - sumSquares[a])) / w - mean * mean;
+					if (variance < 0.0) variance = 0.0;
+					if (mean > 0.0) {
+						double logVariance = log(1.0 + variance / (mean * mean));
+						duration = exp(log(mean) - 0.5 * logVariance + sqrt(logVariance) * z[lane]);
+					}
+				}
+
+				total[lane] += duration;
+				currentTime[lane] += duration;
+				if (currentTime[lane] >= 86400.0) currentTime[lane] = fmod(currentTime[lane], 86400.0); // Wrap around midnight, a draw can exceed a day
+			}
+		}
+
+		int lanes = batchSamples - base;
+		if (lanes > MC_LANES) lanes = MC_LANES;
+		for (int lane = 0; lane < lanes; lane++) {
+			int bin = (int)(total[lane] / MC_HISTOGRAM_BIN_SECONDS);
+			if (bin < MC_HISTOGRAM_BINS) histogram[bin]++;
+			else overflow++;
+			sum += total[lane];
+			sumSquares += total[lane] * total[lane];
+		}
+	}
+
+	ctx->overflowCounts[batch] = overflow;
+	ctx->sums[batch] = sum;
+	ctx->sumSquares[batch] = sumSquares;
+}
+
+// Quantile of the simulated route duration, interpolated within histogram bins
+double routeDistributionQuantile(RouteDistribution* distribution, double q) {
+	double target = q * distribution->numSamples;
+	double cumulative = 0.0;
+
+	for (int b = 0; b < MC_HISTOGRAM_BINS; b++) {
+		double count = (double)distribution->histogram[b];
+		if (count > 0 && cumulative + count >= target) {
+			double fraction = (target - cumulative) / count;
+			return (b + fraction) * MC_HISTOGRAM_BIN_SECONDS;
+		}
+		cumulative += count;
+	}
+	return (double)MC_HISTOGRAM_BINS * MC_HISTOGRAM_BIN_SECONDS; // Quantile lies in the overflow
+}
+
+// Monte Carlo distribution of the route duration for a departure time on the tables' reference date.
+// Batches are seeded from (seed, batch index), so results do not depend on the number of threads.
+// Returns 0 on success, -1 on failure.
+int simulateRouteDistribution(KernelTables* tables, int departureTime, int numSamples, unsigned long long seed, RouteDistribution* result) {
+	auto start = std::chrono::steady_clock::now();
+
+	memset(result, 0, sizeof(RouteDistribution));
+	result->departureTime = departureTime;
+	if (numSamples <= 0) return -1;
+
+	SimulationContext ctx;
+	ctx.numBatches = (numSamples + MC_BATCH_SAMPLES - 1) / MC_BATCH_SAMPLES;
+	ctx.lookup = (StepLookup*)malloc(sizeof(StepLookup));
+	ctx.histograms = (long long*)calloc((size_t)ctx.numBatches * MC_HISTOGRAM_BINS, sizeof(long long));
+	ctx.overflowCounts = (long long*)calloc(ctx.numBatches, sizeof(long long));
+	ctx.sums = (double*)calloc(ctx.numBatches, sizeof(double));
+	ctx.sumSquares = (double*)calloc(ctx.numBatches, sizeof(double));
+
+	if (!ctx.lookup || !ctx.histograms || !ctx.overflowCounts || !ctx.sums || !ctx.sumSquares) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		free(ctx.lookup);
+		free(ctx.histograms);
+		free(ctx.overflowCounts);
+		free(ctx.sums);
+		free(ctx.sumSquares);
+		return -1;
+	}
+
+	buildStepLookup(tables, ctx.lookup);
+	ctx.departureTime = ((departureTime % 86400) + 86400) % 86400;
+	ctx.numSamples = numSamples;
+	ctx.seed = seed;
+
+	parallelFor(ctx.numBatches, simulateBatch, &ctx);
+
+	// Merge batch results
+	double sum = 0.0;
+	double sumSquares = 0.0;
+	for (int batch = 0; batch < ctx.numBatches; batch++) {
+		long long* histogram = ctx.histograms + (long long)batch * MC_HISTOGRAM_BINS;
+		for (int b = 0; b < MC_HISTOGRAM_BINS; b++) {
+			result->histogram[b] += histogram[b];
+		}
+		result->overflowCount += ctx.overflowCounts[batch];
+		sum += ctx.sums[batch];
+		sumSquares += ctx.sumSquares[batch];
+	}
+
+	result->numSamples = numSamples;
+	result->mean = sum / numSamples;
+	double variance = sumSquares / numSamples - result->mean * result->mean;
+	result->stddev = (variance > 0.0) ? sqrt(variance) : 0.0;
+	result->p50 = routeDistributionQuantile(result, 0.50);
+	result->p90 = routeDistributionQuantile(result, 0.90);
+	result->p95 = routeDistributionQuantile(result, 0.95);
+
+	free(ctx.lookup);
+	free(ctx.histograms);
+	free(ctx.overflowCounts);
+	free(ctx.sums);
+	free(ctx.sumSquares);
+
+	result->elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef MONTE_CARLO_H
+#define MONTE_CARLO_H
+
+#include "kernel_tables.h"
+
+#define MC_LANES 8                 // Samples simulated in lockstep, sized for 256/512-bit vector units
+#define MC_BATCH_SAMPLES 4096      // Samples per parallel task
+#define MC_HISTOGRAM_BIN_SECONDS 10
+#define MC_HISTOGRAM_BINS 1080     // Covers route durations up to 3 hours
+
+// Distribution of the full-route duration for one departure time
+typedef struct {
+	int departureTime;         // Seconds after midnight
+	int numSamples;
+	double mean;
+	double stddev;
+	double p50;
+	double p90;
+	double p95;
+	long long overflowCount;   // Samples longer than the histogram range
+	long long histogram[MC_HISTOGRAM_BINS]; // Sample counts per MC_HISTOGRAM_BIN_SECONDS of route duration
+	double elapsedMs;          // Wall-clock simulation time
+} RouteDistribution;
+
+int simulateRouteDistribution(KernelTables* tables, int departureTime, int numSamples, unsigned long long seed, RouteDistribution* result);
+double routeDistributionQuantile(RouteDistribution* distribution, double q);
+
+#endif // monte_carlo_h
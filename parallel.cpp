@@ -0,0 +1,139 @@
+#include "parallel.h"
+
+#include <stdlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+int hardwareThreadCount() {
+	unsigned int count = std::thread::hardware_concurrency();
+	return (count > 0) ? (int)count : 1;
+}
+
+static thread_local int insideParallelFor = 0; // Set on pool workers and on a caller while it runs tasks
+
+// Worker threads started on the first parallelFor and kept for the life of the program, so their
+// scratch buffers (threadScratch) survive from one call to the next
+struct WorkerPool {
+	std::mutex mutex;
+	std::condition_variable wake;  // Workers wait here for the next job
+	std::condition_variable done;  // parallelFor waits here for the workers to finish a job
+	std::vector<std::thread> threads;
+
+	// Current job
+	ParallelTask task;
+	void* context;
+	int taskCount;
+	std::atomic<int> nextTask;
+	int generation;   // Incremented for every job
+	int busyWorkers;  // Workers still on the current job
+	int stopping;
+
+	WorkerPool() : task(NULL), context(NULL), taskCount(0), nextTask(0), generation(0), busyWorkers(0), stopping(0) {
+		for (int t = 1; t < hardwareThreadCount(); t++) {
+			threads.emplace_back(&WorkerPool::workerLoop, this);
+		}
+	}
+
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = 1;
+		}
+		wake.notify_all();
+		for (size_t t = 0; t < threads.size(); t++) {
+			threads[t].join();
+		}
+	}
+
+	// Tasks are handed out dynamically, so uneven task costs still balance across threads
+	void runTasks() {
+		for (int i = nextTask.fetch_add(1); i < taskCount; i = nextTask.fetch_add(1)) {
+			task(i, context);
+		}
+	}
+
+	void workerLoop() {
+		insideParallelFor = 1;
+		int seenGeneration = 0;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		for (;;) {
+			wake.wait(lock, [&]() { return stopping || generation != seenGeneration; });
+			if (stopping) return;
+			seenGeneration = generation;
+
+			lock.unlock();
+			runTasks();
+			lock.lock();
+
+			if (--busyWorkers == 0) done.notify_one();
+		}
+	}
+};
+
+static std::mutex submitMutex; // One job at a time, parallelFor calls from several threads queue up
+
+// Run task(0..taskCount-1, context) across the available hardware threads and wait for all of them.
+// The calling thread takes part in the work, so a single-core machine runs everything inline, and so
+// does a parallelFor called from inside a task.
+void parallelFor(int taskCount, ParallelTask task, void* context) {
+	if (taskCount <= 0) return;
+
+	if (taskCount == 1 || insideParallelFor || hardwareThreadCount() == 1) {
+		for (int i = 0; i < taskCount; i++) task(i, context);
+		return;
+	}
+
+	std::lock_guard<std::mutex> submit(submitMutex);
+	static WorkerPool pool;
+
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.task = task;
+		pool.context = context;
+		pool.taskCount = taskCount;
+		pool.nextTask = 0;
+		pool.busyWorkers = (int)pool.threads.size();
+		pool.generation++;
+	}
+	pool.wake.notify_all();
+
+	insideParallelFor = 1;
+	pool.runTasks();
+	insideParallelFor = 0;
+
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	pool.done.wait(lock, [&]() { return pool.busyWorkers == 0; });
+}
+
+// Scratch buffers owned by one thread, released when the thread exits (pool workers at program exit)
+struct ScratchPool {
+	double* buffers[SCRATCH_SLOTS];
+	int capacities[SCRATCH_SLOTS];
+
+	~ScratchPool() {
+		for (int i = 0; i < SCRATCH_SLOTS; i++) free(buffers[i]);
+	}
+};
+
+static thread_local ScratchPool scratchPool; // Zero-initialized per thread
+
+// Per-thread scratch buffer of at least count doubles. The buffer is reused by later calls on the
+// same thread and only reallocated when a larger one is requested, so steady-state queries do no
+// heap allocation. Contents are not preserved across calls. Returns NULL if allocation fails.
+double* threadScratch(int slot, int count) {
+	if (slot < 0 || slot >= SCRATCH_SLOTS) return NULL;
+
+	if (scratchPool.capacities[slot] < count) {
+		int capacity = (scratchPool.capacities[slot] > 0) ? scratchPool.capacities[slot] * 2 : 1024;
+		if (capacity < count) capacity = count;
+
+		free(scratchPool.buffers[slot]);
+		scratchPool.buffers[slot] = (double*)malloc(capacity * sizeof(double));
+		scratchPool.capacities[slot] = scratchPool.buffers[slot] ? capacity : 0;
+	}
+	return scratchPool.buffers[slot];
+}
@@ -0,0 +1,16 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Minimal thread pool helpers for batch workloads (Monte Carlo batches, backtest folds, grid points).
+// Worker threads persist between calls, so each keeps its threadScratch buffers from one batch to the next.
+// Tasks are handed out dynamically, so uneven task costs still balance across threads.
+
+typedef void (*ParallelTask)(int taskIndex, void* context);
+
+#define SCRATCH_SLOTS 4 // Independent scratch buffers per thread
+
+int hardwareThreadCount();
+void parallelFor(int taskCount, ParallelTask task, void* context);
+double* threadScratch(int slot, int count);
+
+#endif // parallel_h
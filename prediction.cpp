@@ -1,4 +1,17 @@
 #include "prediction.h"
+#include "parallel.h"
+
+#include <string.h>
+
+ModelParams defaultModelParams() {
+	ModelParams params;
+	params.halfLifeDays = HALF_LIFE_DAYS;
+	params.timeSigmaSeconds = HALF_LIFE_SECONDS;
+	params.sameDOWWeight = SAME_DOW_WEIGHT;
+	params.adjacentDOWWeight = ADJACENT_DOW_WEIGHT;
+	params.dayClassWeight = DAY_CLASS_WEIGHT;
+	return params;
+}
 
 // Calculate the day of the week for a given date using Zeller's Congruence
 int getDayOfWeek(ValidTraversal* traversal) {
@@ -32,55 +45,47 @@ int getDayOfWeek(ValidTraversal* traversal) {
 	return dayOfWeek;
 }
 
-// Calculate the number of days between two dates
-int daysBetween (int year1, int month1, int day1, int year2, int month2, int day2) {
+// Day count for a date, only meaningful as a difference between two dates
+int dayIndex(int year, int month, int day) {
 	int monthLengths[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 }; // Days in each month
-	int days1 = 0;
-	int days2 = 0;
-
-	// Date 1 calculations
-	days1 = year1 * 365 + (year1 / 4) - (year1 / 100) + (year1 / 400); // Leap year adjustments
-	for (int m = 1; m < month1; m++) {
-		days1 += monthLengths[m - 1]; // Add days for each month leading up to month1
-		if (m == 2 && ((year1 % 4 == 0 && year1 % 100 != 0) || (year1 % 400 == 0))) {
-			days1 += 1; // Leap year
-		}
-	}
-	days1 += day1; // Add days in the current month
-	
-	// Calculations for date 2
-	days2 = year2 * 365 + (year2 / 4) - (year2 / 100) + (year2 / 400); // Leap year adjustments
-	for (int m = 1; m < month2; m++) { // Add days for each month leading up to month2
-		days2 += monthLengths[m - 1];
-		if (m == 2 && ((year2 % 4 == 0 && year2 % 100 != 0) || (year2 % 400 == 0))) {
-			days2 += 1; // Leap year
+	int days = 0;
+
+	days = year * 365 + (year / 4) - (year / 100) + (year / 400); // Leap year adjustments
+	for (int m = 1; m < month; m++) {
+		days += monthLengths[m - 1]; // Add days for each month leading up to month
+		if (m == 2 && ((year % 4 == 0 && year % 100 != 0) || (year % 400 == 0))) {
+			days += 1; // Leap year
 		}
 	}
-	days2 += day2; // Add days in the current month
+	days += day; // Add days in the current month
 
-	return abs(days2 - days1);
+	return days;
 }
 
-double computeWeights(ValidTraversal t, int targetTime, int targetDOW, int targetYear, int targetMonth, int targetDay) {
-	double weight = 1.0;
-	double dowWeight = 1.0;
-	double timeWeight = 1.0;
-	double dateWeight = 1.0;
-
-	int dow = getDayOfWeek(&t);
+// Calculate the number of days between two dates
+int daysBetween (int year1, int month1, int day1, int year2, int month2, int day2) {
+	return abs(dayIndex(year2, month2, day2) - dayIndex(year1, month1, day1));
+}
 
-	int diff = abs(t.startTime - targetTime);
+// Gaussian decay based on the time-of-day difference (std dev = params->timeSigmaSeconds), wrapping around midnight
+double timeOfDayWeight(int startTime, int targetTime, ModelParams* params) {
+	int diff = abs(startTime - targetTime);
 	int timeDiff = (diff > 43200) ? (86400 - diff) : diff;  // wrap around midnight
 
-	timeWeight = exp(-0.5 * pow(timeDiff / HALF_LIFE_SECONDS, 2.0)); // Gaussian decay based on time difference (std dev = 30 minutes)
+	return exp(-0.5 * pow(timeDiff / params->timeSigmaSeconds, 2.0));
+}
+
+// Weight for the day of week of a traversal relative to the target day of week
+double dayOfWeekWeight(int dow, int targetDOW, ModelParams* params) {
+	double dowWeight = 1.0;
 
 	int dowDiff = abs(dow - targetDOW); // difference in day of week
 
 	if(dowDiff == 0) {
-		dowWeight = 2.0; // Higher weight for same day of week
+		dowWeight = params->sameDOWWeight; // Higher weight for same day of week
 	}
 	else if(dowDiff == 1) {
-		dowWeight = 1.2; // Medium weight for adjacent days
+		dowWeight = params->adjacentDOWWeight; // Medium weight for adjacent days
 	}
 	else {
 		dowWeight = 1.0; // Lower weight for other days
@@ -88,24 +93,77 @@ double computeWeights(ValidTraversal t, int targetTime, int targetDOW, int targe
 
 	if(dow > 1 && dow < 6 && targetDOW > 1 && targetDOW < 6) {
 		// Apply additional weighting if both days are on weekdays
-		dowWeight *= 1.2;
+		dowWeight *= params->dayClassWeight;
 	}
 	else if ((dow == 0 || dow == 6) && (targetDOW == 0 || targetDOW == 6)) {
 		// Apply additional weighting if both days are on weekends
-		dowWeight *= 1.2;
+		dowWeight *= params->dayClassWeight;
 	}
 
-	int dateDiff = daysBetween(t.year, t.month, t.day, targetYear, targetMonth, targetDay);
-	dateWeight = pow(2.0, (double)-abs(dateDiff) / HALF_LIFE_DAYS); // Exponential decay based on date difference
+	return dowWeight;
+}
+
+// Exponential decay based on the number of days between a traversal and the target date
+double dateDecayFromDays(int dateDiff, ModelParams* params) {
+	double dateWeight = pow(2.0, (double)-abs(dateDiff) / params->halfLifeDays);
 
 	if (dateWeight < 1e-6) dateWeight = 1e-6; // Prevent weights from becoming too small over long periods of time
 
+	return dateWeight;
+}
+
+double dateDecayWeight(ValidTraversal* t, int targetYear, int targetMonth, int targetDay, ModelParams* params) {
+	return dateDecayFromDays(daysBetween(t->year, t->month, t->day, targetYear, targetMonth, targetDay), params);
+}
+
+double computeWeights(ValidTraversal t, int targetTime, int targetDOW, int targetYear, int targetMonth, int targetDay, ModelParams* params) {
+	double weight = 1.0;
+	double dowWeight = 1.0;
+	double timeWeight = 1.0;
+	double dateWeight = 1.0;
+
+	int dow = getDayOfWeek(&t);
+
+	timeWeight = timeOfDayWeight(t.startTime, targetTime, params);
+	dowWeight = dayOfWeekWeight(dow, targetDOW, params);
+	dateWeight = dateDecayWeight(&t, targetYear, targetMonth, targetDay, params);
+
 	// Compute weights by multiplying individual weights
 	weight = timeWeight * dowWeight * dateWeight;
 
 	return weight;	
 }
 
+// Precompute the query-independent parts of computeWeights for each traversal, so repeated
+// predictions over the same history (backtests, tuning) skip the calendar arithmetic.
+// Traversals of unknown segments get segmentIndex -1.
+void computeTraversalFeatures(Segment* segments, int numSegments, TraversalStore* traversals, TraversalFeatures* features) {
+	for (int i = 0; i < traversals->count; i++) {
+		ValidTraversal* t = traversalAt(traversals, i);
+
+		features[i].segmentIndex = -1;
+		for (int j = 0; j < numSegments; j++) {
+			if (segments[j].segment_id == t->segment_id) {
+				features[i].segmentIndex = j;
+				break;
+			}
+		}
+		features[i].duration = t->duration;
+		features[i].startTime = t->startTime;
+		features[i].dow = getDayOfWeek(t);
+		features[i].dayIndex = dayIndex(t->year, t->month, t->day);
+	}
+}
+
+// Same weight as computeWeights, from precomputed features
+double computeFeatureWeight(TraversalFeatures* f, int targetTime, int targetDOW, int targetDayIndex, ModelParams* params) {
+	double timeWeight = timeOfDayWeight(f->startTime, targetTime, params);
+	double dowWeight = dayOfWeekWeight(f->dow, targetDOW, params);
+	double dateWeight = dateDecayFromDays(targetDayIndex - f->dayIndex, params);
+
+	return timeWeight * dowWeight * dateWeight;
+}
+
 // Inputs: arrays of durations and corresponding weights, and the count of elements
 // Outputs: weighted mean and standard deviation as a combined double (mean in integer part, stddev in fractional part)
 void weightedMeanAndStd(double* durations, double* weights, int count, double *mean, double *stddev) {
@@ -142,37 +200,139 @@ void weightedMeanAndStd(double* durations, double* weights, int count, double *m
 	*stddev = sqrt(variance);
 }
 
-void predictSegmentDuration(int* segment_id, ValidTraversal *traversals, int traversalCount, int targetYear, int targetMonth, int targetDay, int targetTime, int targetDOW, double* predictedMean, double* predictedStdDev) {
-	double* durations = (double*) malloc(MAX_TRAVERSALS * sizeof(double));
-	double* weights = (double*) malloc(MAX_TRAVERSALS * sizeof(double));
+// Group the features of a traversal history by segment, so repeated predictions over the same history
+// (backtests) skip the calendar arithmetic and only scan their own segment's traversals.
+// Returns 0 on success, -1 on failure.
+int buildFeatureIndex(Segment* segments, int numSegments, TraversalStore* traversals, FeatureIndex* index) {
+	int traversalCount = traversals->count;
+	int n = (traversalCount > 0) ? traversalCount : 1;
+
+	memset(index, 0, sizeof(FeatureIndex));
+	index->numSegments = numSegments;
+	index->traversalCount = traversalCount;
+	index->features = (TraversalFeatures*)malloc(n * sizeof(TraversalFeatures));
+	index->bySegment = (int*)malloc(n * sizeof(int));
+	index->segmentOffsets = (int*)calloc(numSegments + 1, sizeof(int));
+	int* fill = (int*)malloc((numSegments > 0 ? numSegments : 1) * sizeof(int));
+
+	if (!index->features || !index->bySegment || !index->segmentOffsets || !fill) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		freeFeatureIndex(index);
+		free(fill);
+		return -1;
+	}
+
+	computeTraversalFeatures(segments, numSegments, traversals, index->features);
+
+	// Counting sort by segment keeps chronological order within a segment
+	for (int i = 0; i < traversalCount; i++) {
+		if (index->features[i].segmentIndex >= 0) index->segmentOffsets[index->features[i].segmentIndex + 1]++;
+	}
+	for (int s = 0; s < numSegments; s++) {
+		if (index->segmentOffsets[s + 1] > index->maxPerSegment) index->maxPerSegment = index->segmentOffsets[s + 1];
+		index->segmentOffsets[s + 1] += index->segmentOffsets[s];
+	}
+	memcpy(fill, index->segmentOffsets, numSegments * sizeof(int));
+	for (int i = 0; i < traversalCount; i++) {
+		if (index->features[i].segmentIndex >= 0) index->bySegment[fill[index->features[i].segmentIndex]++] = i;
+	}
+	free(fill);
+	return 0;
+}
+
+void freeFeatureIndex(FeatureIndex* index) {
+	free(index->features);
+	free(index->bySegment);
+	free(index->segmentOffsets);
+	index->features = NULL;
+	index->bySegment = NULL;
+	index->segmentOffsets = NULL;
+}
+
+// Segment prediction scanning the traversal store, leaving out traversals from excludedDayIndex.
+// Returns -1 (with a zero prediction) if the scratch buffers cannot be allocated.
+static int collectSegmentDuration(int segment_id, TraversalStore* traversals, int targetYear, int targetMonth, int targetDay, int targetTime, int targetDOW, int excludedDayIndex, double* predictedMean, double* predictedStdDev, ModelParams* params) {
+	double* durations = threadScratch(0, traversals->count > 0 ? traversals->count : 1);
+	double* weights = threadScratch(1, traversals->count > 0 ? traversals->count : 1);
 	int count = 0;
 
-	// Collect durations and weights for the specified segment from array of all traversals
-	for(int i = 0; i < traversalCount; i++) {
-		if(traversals[i].segment_id == *segment_id) {
-			durations[count] = (double)traversals[i].duration; // Store duration
-			weights[count] = computeWeights(traversals[i], targetTime, targetDOW, targetYear, targetMonth, targetDay); // Compute and store weight
+	if (durations == NULL || weights == NULL) {
+		*predictedMean = 0.0;
+		*predictedStdDev = 0.0;
+		return -1;
+	}
+
+	// Collect durations and weights for the specified segment from all traversals
+	for(int i = 0; i < traversals->count; i++) {
+		ValidTraversal* t = traversalAt(traversals, i);
+		if(t->segment_id == segment_id) {
+			if (excludedDayIndex != NO_EXCLUDED_DAY && dayIndex(t->year, t->month, t->day) == excludedDayIndex) continue;
+			durations[count] = (double)t->duration; // Store duration
+			weights[count] = computeWeights(*t, targetTime, targetDOW, targetYear, targetMonth, targetDay, params); // Compute and store weight
 			count++;
 		}
 	}
 
 	weightedMeanAndStd(durations, weights, count, predictedMean, predictedStdDev);
+	return 0;
+}
+
+// Same as collectSegmentDuration from a feature index, with the same weights via computeFeatureWeight
+static int collectSegmentDurationFromIndex(FeatureIndex* index, int segmentIndex, int targetTime, int targetDOW, int targetDayIndex, int excludedDayIndex, double* predictedMean, double* predictedStdDev, ModelParams* params) {
+	double* durations = threadScratch(0, index->maxPerSegment > 0 ? index->maxPerSegment : 1);
+	double* weights = threadScratch(1, index->maxPerSegment > 0 ? index->maxPerSegment : 1);
+	int count = 0;
+
+	if (durations == NULL || weights == NULL) {
+		*predictedMean = 0.0;
+		*predictedStdDev = 0.0;
+		return -1;
+	}
+
+	for (int k = index->segmentOffsets[segmentIndex]; k < index->segmentOffsets[segmentIndex + 1]; k++) {
+		TraversalFeatures* f = &index->features[index->bySegment[k]];
+		if (f->dayIndex == excludedDayIndex) continue;
+
+		durations[count] = (double)f->duration;
+		weights[count] = computeFeatureWeight(f, targetTime, targetDOW, targetDayIndex, params);
+		count++;
+	}
 
-	free(durations);
-	free(weights);
+	weightedMeanAndStd(durations, weights, count, predictedMean, predictedStdDev);
+	return 0;
+}
+
+// Scratch buffers come from the calling thread's pool, so repeated queries do not touch the heap
+void predictSegmentDuration(int* segment_id, TraversalStore* traversals, int targetYear, int targetMonth, int targetDay, int targetTime, int targetDOW, double* predictedMean, double* predictedStdDev, ModelParams* params) {
+	if (collectSegmentDuration(*segment_id, traversals, targetYear, targetMonth, targetDay, targetTime, targetDOW, NO_EXCLUDED_DAY, predictedMean, predictedStdDev, params) != 0) {
+		fprintf(stderr, "Memory allocation failed.\n");
+	}
 }
 
-void predictOverallDuration(Segment* segments, ValidTraversal* traversals, int traversalCount, int targetTime, int targetDay, int targetMonth, int targetYear, int targetDOW, double* routeMean, double* routeStddev) {
+// Route prediction walking forward from segments[startSegment] to the last segment, each segment
+// predicted at the time the previous ones are expected to end. Traversals from excludedDayIndex
+// (a dayIndex() value, NO_EXCLUDED_DAY to keep all) are left out. With a feature index built from
+// the same store the traversals are read from the index instead of the store. This is the one
+// prediction path shared by predictOverallDuration and the backtest.
+// Returns 0 on success, -1 if scratch allocation failed for any segment.
+int predictRouteDuration(Segment* segments, int startSegment, int numSegments, TraversalStore* traversals, FeatureIndex* index, int targetTime, int targetDay, int targetMonth, int targetYear, int targetDOW, int excludedDayIndex, double* routeMean, double* routeStddev, ModelParams* params) {
 	double totalDuration = 0.0;
 	double totalVar = 0.0;
+	int result = 0;
 
 	double currentTime = targetTime;
+	int targetDayIndex = dayIndex(targetYear, targetMonth, targetDay);
 
 	double segmentMean = 0.0;
 	double segmentStdDev = 0.0;
 
-	for (int i = 0; i < NUM_SEGMENTS; i++) {
-		predictSegmentDuration(&segments[i].segment_id, traversals, traversalCount, targetYear, targetMonth, targetDay, currentTime, targetDOW, &segmentMean, &segmentStdDev);
+	for (int i = startSegment; i < numSegments; i++) {
+		if (index) {
+			if (collectSegmentDurationFromIndex(index, i, currentTime, targetDOW, targetDayIndex, excludedDayIndex, &segmentMean, &segmentStdDev, params) != 0) result = -1;
+		}
+		else {
+			if (collectSegmentDuration(segments[i].segment_id, traversals, targetYear, targetMonth, targetDay, currentTime, targetDOW, excludedDayIndex, &segmentMean, &segmentStdDev, params) != 0) result = -1;
+		}
 		totalDuration += segmentMean;
 		totalVar += segmentStdDev * segmentStdDev;
 
@@ -184,5 +344,11 @@ void predictOverallDuration(Segment* segments, ValidTraversal* traversals, int t
 
 	*routeMean = totalDuration;
 	*routeStddev = sqrt(totalVar);
+	return result;
+}
 
+void predictOverallDuration(Segment* segments, TraversalStore* traversals, int targetTime, int targetDay, int targetMonth, int targetYear, int targetDOW, double* routeMean, double* routeStddev, ModelParams* params) {
+	if (predictRouteDuration(segments, 0, NUM_SEGMENTS, traversals, NULL, targetTime, targetDay, targetMonth, targetYear, targetDOW, NO_EXCLUDED_DAY, routeMean, routeStddev, params) != 0) {
+		fprintf(stderr, "Memory allocation failed.\n");
+	}
 }
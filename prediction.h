@@ -1,16 +1,66 @@
+#ifndef PREDICTION_H
+#define PREDICTION_H
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <limits.h>
 
 #include "esp_data.h"
 
 #define HALF_LIFE_DAYS 30.0
 #define HALF_LIFE_SECONDS 1800.0 // 30 minutes
-#define MAX_TRAVERSALS 1000
+#define SAME_DOW_WEIGHT 2.0
+#define ADJACENT_DOW_WEIGHT 1.2
+#define DAY_CLASS_WEIGHT 1.2     // Both weekdays or both weekend days
 #define NUM_SEGMENTS 12
+#define PI 3.14159265358979323846
+#define NO_EXCLUDED_DAY INT_MIN  // excludedDayIndex that keeps every traversal
+
+// Runtime weighting parameters of the model, defaults come from the #defines above
+typedef struct {
+	double halfLifeDays;      // Half-life of the date decay
+	double timeSigmaSeconds;  // Std dev of the time-of-day Gaussian
+	double sameDOWWeight;     // Multiplier for the same day of week
+	double adjacentDOWWeight; // Multiplier for adjacent days of week
+	double dayClassWeight;    // Extra multiplier when both days are weekdays or both are weekend days
+} ModelParams;
+
+// Query-independent inputs of computeWeights for one traversal
+typedef struct {
+	int segmentIndex; // Index into the segments array, -1 if unknown
+	int duration;
+	int startTime;
+	int dow;
+	int dayIndex;     // Day count from dayIndex(), differences give daysBetween
+} TraversalFeatures;
 
+// Features of a traversal history grouped by segment, from buildFeatureIndex
+typedef struct {
+	int numSegments;
+	int traversalCount;
+	TraversalFeatures* features; // One per traversal, in store order
+	int* bySegment;              // Traversal indices grouped by segment, chronological within a segment
+	int* segmentOffsets;         // bySegment range of segment i is [segmentOffsets[i], segmentOffsets[i + 1])
+	int maxPerSegment;           // Largest number of traversals of one segment
+} FeatureIndex;
+
+ModelParams defaultModelParams();
 int getDayOfWeek(ValidTraversal* traversal);
+int dayIndex(int year, int month, int day);
 int daysBetween(int year1, int month1, int day1, int year2, int month2, int day2);
-double computeWeights(ValidTraversal t, int targetTime, int targetDOW, int targetYear, int targetMonth, int targetDay);
+double timeOfDayWeight(int startTime, int targetTime, ModelParams* params);
+double dayOfWeekWeight(int dow, int targetDOW, ModelParams* params);
+double dateDecayFromDays(int dateDiff, ModelParams* params);
+double dateDecayWeight(ValidTraversal* t, int targetYear, int targetMonth, int targetDay, ModelParams* params);
+double computeWeights(ValidTraversal t, int targetTime, int targetDOW, int targetYear, int targetMonth, int targetDay, ModelParams* params);
+void computeTraversalFeatures(Segment* segments, int numSegments, TraversalStore* traversals, TraversalFeatures* features);
+double computeFeatureWeight(TraversalFeatures* f, int targetTime, int targetDOW, int targetDayIndex, ModelParams* params);
+int buildFeatureIndex(Segment* segments, int numSegments, TraversalStore* traversals, FeatureIndex* index);
+void freeFeatureIndex(FeatureIndex* index);
 void weightedMeanAndStd(double* durations, double* weights, int count, double* mean, double* stddev);
-void predictOverallDuration(Segment* segments, ValidTraversal* traversals, int traversalCount, int targetTime, int targetDay, int targetMonth, int targetYear, int targetDOW, double* routeMean, double* routeStddev);
\ No newline at end of file
+void predictSegmentDuration(int* segment_id, TraversalStore* traversals, int targetYear, int targetMonth, int targetDay, int targetTime, int targetDOW, double* predictedMean, double* predictedStdDev, ModelParams* params);
+int predictRouteDuration(Segment* segments, int startSegment, int numSegments, TraversalStore* traversals, FeatureIndex* index, int targetTime, int targetDay, int targetMonth, int targetYear, int targetDOW, int excludedDayIndex, double* routeMean, double* routeStddev, ModelParams* params);
+void predictOverallDuration(Segment* segments, TraversalStore* traversals, int targetTime, int targetDay, int targetMonth, int targetYear, int targetDOW, double* routeMean, double* routeStddev, ModelParams* params);
+
+#endif // prediction_h
@@ -0,0 +1,202 @@
+#include "quantile_sketch.h"
+
+#include <string.h>
+
+void initDigest(QuantileDigest* digest) {
+	digest->numCentroids = 0;
+	digest->numBuffered = 0;
+	digest->totalWeight = 0.0;
+	digest->min = 0.0;
+	digest->max = 0.0;
+}
+
+// t-digest k1 scale function, small steps in k near the tails keep tail centroids small
+static double scaleFunction(double q) {
+	return DIGEST_COMPRESSION / (2.0 * PI) * asin(2.0 * q - 1.0);
+}
+
+static int compareCentroids(const void* a, const void* b) {
+	double ma = ((const Centroid*)a)->mean;
+	double mb = ((const Centroid*)b)->mean;
+	return (ma > mb) - (ma < mb);
+}
+
+// Merge buffered insertions into the centroid list. Neighbouring centroids are combined as long as
+// the merged centroid spans at most one unit of the scale function, which bounds the centroid count
+// to roughly DIGEST_COMPRESSION.
+void digestCompress(QuantileDigest* digest) {
+	if (digest->numBuffered == 0) return;
+
+	Centroid all[DIGEST_MAX_CENTROIDS + DIGEST_BUFFER_SIZE];
+	int count = 0;
+
+	for (int i = 0; i < digest->numCentroids; i++) all[count++] = digest->centroids[i];
+	for (int i = 0; i < digest->numBuffered; i++) all[count++] = digest->buffer[i];
+	digest->numBuffered = 0;
+
+	qsort(all, count, sizeof(Centroid), compareCentroids);
+
+	double total = digest->totalWeight;
+	double weightSoFar = 0.0;
+	double kLeft = scaleFunction(0.0);
+	Centroid current = all[0];
+	int out = 0;
+
+	for (int i = 1; i < count; i++) {
+		double qRight = (weightSoFar + current.weight + all[i].weight) / total;
+		if (qRight > 1.0) qRight = 1.0;
+
+		if (scaleFunction(qRight) - kLeft <= 1.0) {
+			// Absorb into the current centroid
+			current.mean += (all[i].mean - current.mean) * all[i].weight / (current.weight + all[i].weight);
+			current.weight += all[i].weight;
+		}
+		else {
+			digest->centroids[out++] = current;
+			weightSoFar += current.weight;
+			kLeft = scaleFunction(weightSoFar / total);
+			current = all[i];
+		}
+	}
+	digest->centroids[out++] = current;
+	digest->numCentroids = out;
+}
+
+void digestAdd(QuantileDigest* digest, double value, double weight) {
+	if (weight <= 0.0) return;
+
+	if (digest->numBuffered >= DIGEST_BUFFER_SIZE) {
+		digestCompress(digest);
+	}
+
+	if (digest->totalWeight == 0.0) {
+		digest->min = value;
+		digest->max = value;
+	}
+	else {
+		if (value < digest->min) digest->min = value;
+		if (value > digest->max) digest->max = value;
+	}
+
+	digest->buffer[digest->numBuffered].mean = value;
+	digest->buffer[digest->numBuffered].weight = weight;
+	digest->numBuffered++;
+	digest->totalWeight += weight;
+}
+
+// Fold another digest into this one, e.g. to combine sketches built from separate data files
+void digestMerge(QuantileDigest* destination, QuantileDigest* source) {
+	if (source->totalWeight == 0.0) return;
+
+	double sourceMin = source->min;
+	double sourceMax = source->max;
+
+	for (int i = 0; i < source->numCentroids; i++) digestAdd(destination, source->centroids[i].mean, source->centroids[i].weight);
+	for (int i = 0; i < source->numBuffered; i++) digestAdd(destination, source->buffer[i].mean, source->buffer[i].weight);
+
+	// Centroid means lie inside the source range, so carry over its true extremes
+	if (sourceMin < destination->min) destination->min = sourceMin;
+	if (sourceMax > destination->max) destination->max = sourceMax;
+}
+
+// Estimate the q-th quantile (0 <= q <= 1) by interpolating between centroid centres.
+// Returns 0 for an empty digest.
+double digestQuantile(QuantileDigest* digest, double q) {
+	digestCompress(digest);
+
+	if (digest->numCentroids == 0) return 0.0;
+	if (q <= 0.0) return digest->min;
+	if (q >= 1.0) return digest->max;
+	if (digest->numCentroids == 1) {
+		// Spread a single centroid uniformly between the extremes
+		return digest->min + q * (digest->max - digest->min);
+	}
+
+	double target = q * digest->totalWeight;
+	Centroid* c = digest->centroids;
+	int n = digest->numCentroids;
+
+	// Left tail, between the minimum and the centre of the first centroid
+	if (target < c[0].weight / 2.0) {
+		return digest->min + (c[0].mean - digest->min) * target / (c[0].weight / 2.0);
+	}
+
+	double cumulative = 0.0;
+	for (int i = 0; i < n - 1; i++) {
+		double leftCentre = cumulative + c[i].weight / 2.0;
+		double rightCentre = cumulative + c[i].weight + c[i + 1].weight / 2.0;
+		if (target <= rightCentre) {
+			double fraction = (target - leftCentre) / (rightCentre - leftCentre);
+			return c[i].mean + fraction * (c[i + 1].mean - c[i].mean);
+		}
+		cumulative += c[i].weight;
+	}
+
+	// Right tail, between the centre of the last centroid and the maximum
+	double lastCentre = digest->totalWeight - c[n - 1].weight / 2.0;
+	double fraction = (target - lastCentre) / (c[n - 1].weight / 2.0);
+	if (fraction > 1.0) fraction = 1.0;
+	return c[n - 1].mean + (digest->max - c[n - 1].mean) * fraction;
+}
+
+DurationSketches* createDurationSketches(Segment* segments, int numSegments) {
+	DurationSketches* sketches = (DurationSketches*)malloc(sizeof(DurationSketches));
+	if (sketches == NULL) return NULL;
+
+	sketches->numSegments = (numSegments < NUM_SEGMENTS) ? numSegments : NUM_SEGMENTS;
+	for (int i = 0; i < sketches->numSegments; i++) {
+		sketches->segmentIds[i] = segments[i].segment_id;
+		for (int b = 0; b < SKETCH_BUCKETS; b++) {
+			initDigest(&sketches->digests[i][b]);
+		}
+	}
+	return sketches;
+}
+
+void freeDurationSketches(DurationSketches* sketches) {
+	free(sketches);
+}
+
+static int timeBucket(int time) {
+	int bucket = (time % 86400) * SKETCH_BUCKETS / 86400;
+	return (bucket < 0) ? bucket + SKETCH_BUCKETS : bucket;
+}
+
+void addTraversalToSketches(DurationSketches* sketches, ValidTraversal* traversal, double weight) {
+	for (int i = 0; i < sketches->numSegments; i++) {
+		if (sketches->segmentIds[i] == traversal->segment_id) {
+			digestAdd(&sketches->digests[i][timeBucket(traversal->startTime)], (double)traversal->duration, weight);
+			return;
+		}
+	}
+}
+
+void mergeDurationSketches(DurationSketches* destination, DurationSketches* source) {
+	for (int i = 0; i < source->numSegments; i++) {
+		for (int j = 0; j < destination->numSegments; j++) {
+			if (destination->segmentIds[j] != source->segmentIds[i]) continue;
+			for (int b = 0; b < SKETCH_BUCKETS; b++) {
+				digestMerge(&destination->digests[j][b], &source->digests[i][b]);
+			}
+		}
+	}
+}
+
+// Duration quantile for a segment at a time of day. Sparse buckets fall back to the nearest
+// non-empty bucket in time (either direction, wrapping around midnight). Returns -1 if the
+// segment has no data at all.
+double segmentDurationQuantile(DurationSketches* sketches, int segmentIndex, int targetTime, double q) {
+	int bucket = timeBucket(targetTime);
+
+	for (int distance = 0; distance <= SKETCH_BUCKETS / 2; distance++) {
+		int before = (bucket - distance + SKETCH_BUCKETS) % SKETCH_BUCKETS;
+		int after = (bucket + distance) % SKETCH_BUCKETS;
+
+		QuantileDigest* candidate = NULL;
+		if (sketches->digests[segmentIndex][before].totalWeight > 0.0) candidate = &sketches->digests[segmentIndex][before];
+		else if (sketches->digests[segmentIndex][after].totalWeight > 0.0) candidate = &sketches->digests[segmentIndex][after];
+
+		if (candidate) return digestQuantile(candidate, q);
+	}
+	return -1.0;
+}
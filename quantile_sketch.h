@@ -0,0 +1,48 @@
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include "esp_data.h"
+#include "prediction.h"
+
+#define DIGEST_COMPRESSION 64.0   // t-digest compression, bounds the digest to about this many centroids
+#define DIGEST_MAX_CENTROIDS 72   // Merged centroid capacity (always enough for the compression above)
+#define DIGEST_BUFFER_SIZE 64     // Unmerged insertions collected before a merge pass
+#define SKETCH_BUCKETS 48         // Half-hour time-of-day buckets per segment
+
+typedef struct {
+	double mean;
+	double weight;
+} Centroid;
+
+// Merging t-digest: a fixed-size, mergeable summary of a weighted distribution.
+// Accuracy is highest in the tails, which is where p90/p95 queries need it.
+typedef struct {
+	Centroid centroids[DIGEST_MAX_CENTROIDS];
+	int numCentroids;
+	Centroid buffer[DIGEST_BUFFER_SIZE];
+	int numBuffered;
+	double totalWeight;
+	double min;
+	double max;
+} QuantileDigest;
+
+// Per segment and time-of-day bucket duration sketches. Memory is fixed regardless of history length.
+typedef struct {
+	int segmentIds[NUM_SEGMENTS];
+	int numSegments;
+	QuantileDigest digests[NUM_SEGMENTS][SKETCH_BUCKETS];
+} DurationSketches;
+
+void initDigest(QuantileDigest* digest);
+void digestAdd(QuantileDigest* digest, double value, double weight);
+void digestMerge(QuantileDigest* destination, QuantileDigest* source);
+void digestCompress(QuantileDigest* digest);
+double digestQuantile(QuantileDigest* digest, double q);
+
+DurationSketches* createDurationSketches(Segment* segments, int numSegments);
+void freeDurationSketches(DurationSketches* sketches);
+void addTraversalToSketches(DurationSketches* sketches, ValidTraversal* traversal, double weight);
+void mergeDurationSketches(DurationSketches* destination, DurationSketches* source);
+double segmentDurationQuantile(DurationSketches* sketches, int segmentIndex, int targetTime, double q);
+
+#endif // quantile_sketch_h
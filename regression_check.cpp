@@ -0,0 +1,343 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "regression_check.h"
+#include "kernel_tables.h"
+
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+// Settings predictions_output.txt was generated with (the prediction set defaults in main.cpp)
+#define REGRESSION_TARGET_YEAR 2025
+#define REGRESSION_TARGET_MONTH 10
+#define REGRESSION_TARGET_DAY 1
+#define REGRESSION_TARGET_DOW 4
+
+static const char* stageNames[REGRESSION_STAGES] = { "parse", "segmentation", "predictions_exact", "predictions_tables" };
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void keepFastest(StageTiming* stage, double elapsedMs) {
+	if (stage->elapsedMs < 0.0 || elapsedMs < stage->elapsedMs) stage->elapsedMs = elapsedMs;
+}
+
+// Compare the replayed traversals line by line with the committed traversal file
+static int compareTraversals(TraversalStore* traversals, RegressionReport* report) {
+	FILE* file = fopen(REGRESSION_TRAVERSAL_FILE, "r");
+	if (file == NULL) {
+		perror("Error opening " REGRESSION_TRAVERSAL_FILE);
+		return -1;
+	}
+
+	char expected[128];
+	char actual[128];
+	int line = 0;
+	while (fgets(expected, sizeof(expected), file)) {
+		expected[strcspn(expected, "\r\n")] = '\0';
+		if (expected[0] == '\0') continue;
+
+		if (line < traversals->count) {
+			ValidTraversal* t = traversalAt(traversals, line);
+			snprintf(actual, sizeof(actual), "%d,%d,%04d-%02d-%02d,%02d:%02d:%02d",
+				t->segment_id, t->duration, t->year, t->month, t->day,
+				t->startTime / 3600, (t->startTime % 3600) / 60, t->startTime % 60);
+		}
+		else {
+			actual[0] = '\0'; // Missing from the replay
+		}
+
+		line++;
+		if (strcmp(expected, actual) != 0) {
+			if (report->firstTraversalMismatch == 0) report->firstTraversalMismatch = line;
+			report->traversalMismatches++;
+		}
+	}
+	fclose(file);
+
+	report->expectedTraversals = line;
+	if (traversals->count > line) {
+		// Extra traversals in the replay
+		if (report->firstTraversalMismatch == 0) report->firstTraversalMismatch = line + 1;
+		report->traversalMismatches += traversals->count - line;
+	}
+	return 0;
+}
+
+// Compare exact and tabulated route predictions with the committed prediction file
+static int comparePredictions(double* exactMeans, double* exactStddevs, double* tableMeans, double* tableStddevs, RegressionReport* report) {
+	FILE* file = fopen(REGRESSION_PREDICTION_FILE, "r");
+	if (file == NULL) {
+		perror("Error opening " REGRESSION_PREDICTION_FILE);
+		return -1;
+	}
+
+	int hour, minute;
+	double mean, stddev;
+	while (fscanf(file, "Time: %d:%d, Predicted Mean: %lf, Std Dev: %lf\n", &hour, &minute, &mean, &stddev) == 4) {
+		int m = hour * 60 + minute;
+		if (m < 0 || m >= REGRESSION_PREDICTION_MINUTES) continue;
+		report->predictions++;
+
+		double exactError = fmax(fabs(exactMeans[m] - mean), fabs(exactStddevs[m] - stddev));
+		if (exactError > report->maxPredictionError) report->maxPredictionError = exactError;
+		if (exactError > REGRESSION_PREDICTION_TOLERANCE) report->predictionMismatches++;
+
+		double tableError = fmax(fabs(tableMeans[m] - mean), fabs(tableStddevs[m] - stddev));
+		if (tableError > report->maxTableError) report->maxTableError = tableError;
+		if (tableError > REGRESSION_TABLE_TOLERANCE) report->tableMismatches++;
+	}
+	fclose(file);
+
+	if (report->predictions != REGRESSION_PREDICTION_MINUTES) {
+		report->predictionMismatches += REGRESSION_PREDICTION_MINUTES - report->predictions;
+	}
+	return 0;
+}
+
+// Baseline lines are "<build key> <stage> <milliseconds>", only entries for this build are used
+static void readBaseline(RegressionReport* report) {
+	FILE* file = fopen(REGRESSION_BASELINE_FILE, "r");
+	if (file == NULL) return;
+
+	char key[64];
+	char name[64];
+	double milliseconds;
+	while (fscanf(file, "%63s %63s %lf", key, name, &milliseconds) == 3) {
+		if (strcmp(key, REGRESSION_BUILD_KEY) != 0) continue;
+		for (int s = 0; s < REGRESSION_STAGES; s++) {
+			if (strcmp(name, report->stages[s].name) == 0) report->stages[s].baselineMs = milliseconds;
+		}
+	}
+	fclose(file);
+}
+
+// Replace this build's entries in the baseline file, keeping the entries of other builds
+static int writeBaseline(RegressionReport* report) {
+	char* existing = NULL;
+	long length = 0;
+
+	FILE* file = fopen(REGRESSION_BASELINE_FILE, "rb");
+	if (file != NULL) {
+		fseek(file, 0, SEEK_END);
+		length = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		existing = (char*)malloc(length + 1);
+		if (existing == NULL || fread(existing, 1, length, file) != (size_t)length) {
+			fprintf(stderr, "Error reading " REGRESSION_BASELINE_FILE "\n");
+			free(existing);
+			fclose(file);
+			return -1;
+		}
+		existing[length] = '\0';
+		fclose(file);
+	}
+
+	file = fopen(REGRESSION_BASELINE_FILE, "w");
+	if (file == NULL) {
+		perror("Error opening " REGRESSION_BASELINE_FILE);
+		free(existing);
+		return -1;
+	}
+
+	size_t keyLength = strlen(REGRESSION_BUILD_KEY);
+	for (char* line = existing; line != NULL && *line != '\0';) {
+		char* next = strchr(line, '\n');
+		if (next != NULL) *next++ = '\0';
+		line[strcspn(line, "\r")] = '\0';
+
+		int ours = strncmp(line, REGRESSION_BUILD_KEY, keyLength) == 0 && (line[keyLength] == ' ' || line[keyLength] == '\t');
+		if (line[0] != '\0' && !ours) fprintf(file, "%s\n", line);
+		line = next;
+	}
+	for (int s = 0; s < REGRESSION_STAGES; s++) {
+		fprintf(file, "%s %s %.3f\n", REGRESSION_BUILD_KEY, report->stages[s].name, report->stages[s].baselineMs);
+	}
+	fclose(file);
+	free(existing);
+	return 0;
+}
+
+// Replay the bundled GPS log through ingest, segmentation and the prediction set, check the results
+// against the committed output files and time each stage against the committed baseline for this
+// build key. Results come from the first run of each stage, the timing from the fastest of
+// REGRESSION_TIMING_RUNS runs. A stage without a baseline fails the check; with recordBaseline the
+// measured timings replace this build's baseline instead of being checked. Returns 0 if every check
+// passes, 1 if any fails and -1 if the inputs cannot be read.
+int runRegressionCheck(Segment* segments, int numSegments, int recordBaseline, RegressionReport* report) {
+	memset(report, 0, sizeof(RegressionReport));
+	for (int s = 0; s < REGRESSION_STAGES; s++) {
+		report->stages[s].name = stageNames[s];
+		report->stages[s].elapsedMs = -1.0;
+		report->stages[s].baselineMs = -1.0;
+	}
+
+	ESPDataPoint* data = (ESPDataPoint*)malloc(MAX_ESP_DATA_POINTS * sizeof(ESPDataPoint));
+	double* predictions = (double*)malloc(4 * REGRESSION_PREDICTION_MINUTES * sizeof(double));
+	KernelTables* tables = createKernelTables();
+	SegmentBounds* bounds = (SegmentBounds*)malloc((numSegments > 0 ? numSegments : 1) * sizeof(SegmentBounds));
+	if (!data || !predictions || !tables || !bounds) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		free(data);
+		free(predictions);
+		freeKernelTables(tables);
+		free(bounds);
+		return -1;
+	}
+	double* exactMeans = predictions;
+	double* exactStddevs = predictions + REGRESSION_PREDICTION_MINUTES;
+	double* tableMeans = predictions + 2 * REGRESSION_PREDICTION_MINUTES;
+	double* tableStddevs = predictions + 3 * REGRESSION_PREDICTION_MINUTES;
+
+	TraversalStore traversals;
+	initTraversalStore(&traversals);
+	ModelParams params = defaultModelParams();
+	int result = 0;
+
+	setESPDataVerbose(0);
+
+	for (int run = 0; run < REGRESSION_TIMING_RUNS && result == 0; run++) {
+		// Ingest
+		auto start = std::chrono::steady_clock::now();
+		FILE* gpsFile = fopen(REGRESSION_GPS_FILE, "r");
+		int numPoints = getESPData(gpsFile, data);
+		if (gpsFile) fclose(gpsFile);
+		keepFastest(&report->stages[0], millisecondsSince(start));
+		if (numPoints < 0) {
+			result = -1;
+			break;
+		}
+		report->points = numPoints;
+
+		// Segmentation, into a scratch store after the first run
+		TraversalStore scratch;
+		initTraversalStore(&scratch);
+		TraversalStore* store = (run == 0) ? &traversals : &scratch;
+
+		start = std::chrono::steady_clock::now();
+		initSegmentBounds(segments, numSegments, bounds);
+		for (int i = 0; i < numPoints;) {
+			i = processPoint(data, i, segments, bounds, numSegments, numPoints, store);
+		}
+		keepFastest(&report->stages[1], millisecondsSince(start));
+		freeTraversalStore(&scratch);
+
+		// Prediction set, exact path
+		start = std::chrono::steady_clock::now();
+		for (int m = 0; m < REGRESSION_PREDICTION_MINUTES; m++) {
+			double mean, stddev;
+			predictOverallDuration(segments, &traversals, m * 60, REGRESSION_TARGET_DAY, REGRESSION_TARGET_MONTH, REGRESSION_TARGET_YEAR, REGRESSION_TARGET_DOW, &mean, &stddev, &params);
+			if (run == 0) {
+				exactMeans[m] = mean;
+				exactStddevs[m] = stddev;
+			}
+		}
+		keepFastest(&report->stages[2], millisecondsSince(start));
+
+		// Prediction set, kernel tables (build included)
+		start = std::chrono::steady_clock::now();
+		buildKernelTables(tables, segments, numSegments, &traversals, REGRESSION_TARGET_YEAR, REGRESSION_TARGET_MONTH, REGRESSION_TARGET_DAY, REGRESSION_TARGET_DOW, &params);
+		for (int m = 0; m < REGRESSION_PREDICTION_MINUTES; m++) {
+			double mean, stddev;
+			predictOverallDurationTabulated(tables, m * 60, &mean, &stddev);
+			if (run == 0) {
+				tableMeans[m] = mean;
+				tableStddevs[m] = stddev;
+			}
+		}
+		keepFastest(&report->stages[3], millisecondsSince(start));
+	}
+
+	setESPDataVerbose(1);
+
+	if (result == 0) {
+		report->traversals = traversals.count;
+		if (compareTraversals(&traversals, report) != 0) result = -1;
+	}
+	if (result == 0 && comparePredictions(exactMeans, exactStddevs, tableMeans, tableStddevs, report) != 0) {
+		result = -1;
+	}
+	if (result == 0) {
+		// Off-grid table accuracy, outside the timed stages since it runs the exact path ~12,000 times
+		double averageError;
+		compareKernelTables(tables, segments, &traversals, REGRESSION_DENSE_STEP_SECONDS, &report->denseMeanError, &report->denseStdError, &averageError);
+	}
+
+	if (result == 0) {
+		int outputsMatch = report->traversalMismatches == 0 && report->predictionMismatches == 0 && report->tableMismatches == 0 &&
+			report->denseMeanError <= REGRESSION_TABLE_TOLERANCE && report->denseStdError <= REGRESSION_TABLE_TOLERANCE;
+
+		// Timings of a run with wrong results are not worth keeping, they are checked as usual instead
+		if (recordBaseline && outputsMatch) {
+			for (int s = 0; s < REGRESSION_STAGES; s++) {
+				report->stages[s].baselineMs = report->stages[s].elapsedMs;
+				report->stages[s].recorded = 1;
+				report->recordedBaselines++;
+			}
+			if (writeBaseline(report) != 0) result = -1;
+		}
+		else {
+			readBaseline(report);
+			for (int s = 0; s < REGRESSION_STAGES; s++) {
+				StageTiming* stage = &report->stages[s];
+				if (stage->baselineMs < 0.0) {
+					stage->missing = 1;
+					report->missingBaselines++;
+					continue;
+				}
+				stage->slow = stage->elapsedMs > stage->baselineMs * REGRESSION_TIME_FACTOR + REGRESSION_TIME_SLACK_MS;
+				if (stage->slow) report->slowStages++;
+			}
+		}
+
+		report->passed = outputsMatch && report->slowStages == 0 && report->missingBaselines == 0;
+		if (result == 0) result = report->passed ? 0 : 1;
+	}
+
+	freeTraversalStore(&traversals);
+	freeKernelTables(tables);
+	free(bounds);
+	free(predictions);
+	free(data);
+	return result;
+}
+
+void printRegressionReport(RegressionReport* report, FILE* output) {
+	fprintf(output, "Traversals: %d replayed from %d GPS points, %d expected, %d mismatched line(s)",
+		report->traversals, report->points, report->expectedTraversals, report->traversalMismatches);
+	if (report->firstTraversalMismatch > 0) fprintf(output, ", first at line %d", report->firstTraversalMismatch);
+	fprintf(output, " %s\n", report->traversalMismatches == 0 ? "[OK]" : "[FAIL]");
+
+	fprintf(output, "Predictions (exact): %d minutes, max error %.4f s, %d outside %.2f s %s\n",
+		report->predictions, report->maxPredictionError, report->predictionMismatches, REGRESSION_PREDICTION_TOLERANCE,
+		report->predictionMismatches == 0 ? "[OK]" : "[FAIL]");
+	fprintf(output, "Predictions (kernel tables): max error %.4f s, %d outside %.2f s %s\n",
+		report->maxTableError, report->tableMismatches, REGRESSION_TABLE_TOLERANCE,
+		report->tableMismatches == 0 ? "[OK]" : "[FAIL]");
+	int denseOk = report->denseMeanError <= REGRESSION_TABLE_TOLERANCE && report->denseStdError <= REGRESSION_TABLE_TOLERANCE;
+	fprintf(output, "Kernel tables vs exact every %d s: max mean error %.4f s, max std dev error %.4f s %s\n",
+		REGRESSION_DENSE_STEP_SECONDS, report->denseMeanError, report->denseStdError, denseOk ? "[OK]" : "[FAIL]");
+
+	fprintf(output, "Stage               |    time (ms) | baseline (ms), build " REGRESSION_BUILD_KEY "\n");
+	for (int s = 0; s < REGRESSION_STAGES; s++) {
+		StageTiming* stage = &report->stages[s];
+		if (stage->recorded) {
+			fprintf(output, "%-19s | %12.3f |      recorded\n", stage->name, stage->elapsedMs);
+		}
+		else if (stage->missing) {
+			fprintf(output, "%-19s | %12.3f |       missing [FAIL]\n", stage->name, stage->elapsedMs);
+		}
+		else {
+			fprintf(output, "%-19s | %12.3f | %13.3f %s\n", stage->name, stage->elapsedMs, stage->baselineMs, stage->slow ? "[SLOW]" : "[OK]");
+		}
+	}
+	if (report->recordedBaselines > 0) {
+		fprintf(output, "%d stage timing(s) recorded to " REGRESSION_BASELINE_FILE " for " REGRESSION_BUILD_KEY ", commit the file to keep them\n", report->recordedBaselines);
+	}
+	if (report->missingBaselines > 0) {
+		fprintf(output, "WARNING: " REGRESSION_BASELINE_FILE " has no timings for %d stage(s) of " REGRESSION_BUILD_KEY ", record them with --record\n", report->missingBaselines);
+	}
+
+	fprintf(output, "Regression check %s\n", report->passed ? "PASSED" : "FAILED");
+}
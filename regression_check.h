@@ -0,0 +1,89 @@
+#ifndef REGRESSION_CHECK_H
+#define REGRESSION_CHECK_H
+
+#include <stdio.h>
+
+#include "esp_data.h"
+#include "prediction.h"
+
+#define REGRESSION_GPS_FILE "gpsdata.txt"
+#define REGRESSION_TRAVERSAL_FILE "traversals_output.txt"
+#define REGRESSION_PREDICTION_FILE "predictions_output.txt"
+#define REGRESSION_BASELINE_FILE "regression_baseline.txt" // Reference stage timings, one set per build key
+
+// Timings only compare within one platform and build type, so baseline entries are keyed on both
+#if defined(_MSC_VER)
+#define REGRESSION_COMPILER "msvc"
+#elif defined(__clang__)
+#define REGRESSION_COMPILER "clang"
+#elif defined(__GNUC__)
+#define REGRESSION_COMPILER "gcc"
+#else
+#define REGRESSION_COMPILER "cc"
+#endif
+
+#if defined(_WIN32)
+#define REGRESSION_PLATFORM "windows"
+#elif defined(__APPLE__)
+#define REGRESSION_PLATFORM "macos"
+#elif defined(__linux__)
+#define REGRESSION_PLATFORM "linux"
+#else
+#define REGRESSION_PLATFORM "other"
+#endif
+
+#if defined(_DEBUG) || (defined(__GNUC__) && !defined(__OPTIMIZE__))
+#define REGRESSION_BUILD_TYPE "debug"
+#else
+#define REGRESSION_BUILD_TYPE "release"
+#endif
+
+#define REGRESSION_BUILD_KEY REGRESSION_PLATFORM "-" REGRESSION_COMPILER "-" REGRESSION_BUILD_TYPE
+
+#define REGRESSION_PREDICTION_TOLERANCE 0.01 // Seconds, exact-path predictions (the files hold 2 decimals)
+#define REGRESSION_TABLE_TOLERANCE 0.5       // Seconds, kernel-table predictions against the exact-path file (the
+                                             // tables stay within 0.45 s of the exact path at any second of the day)
+#define REGRESSION_TIME_FACTOR 2.0           // A stage fails when slower than baseline * factor + slack
+#define REGRESSION_TIME_SLACK_MS 2.0         // Absorbs timer noise on stages that take a few milliseconds
+#define REGRESSION_TIMING_RUNS 5             // Each stage is timed this many times and the fastest run kept
+#define REGRESSION_STAGES 4
+#define REGRESSION_PREDICTION_MINUTES 1440   // predictions_output.txt has one line per minute of the day
+#define REGRESSION_DENSE_STEP_SECONDS 7      // Tables are also checked against the exact path every 7 s, covering
+                                             // every offset between table steps
+
+typedef struct {
+	const char* name;
+	double elapsedMs;   // Fastest of REGRESSION_TIMING_RUNS
+	double baselineMs;
+	int missing;        // 1 if the baseline has no entry for the stage under this build key
+	int recorded;       // 1 if this run's timing was stored as the new baseline
+	int slow;           // 1 if over the allowed time
+} StageTiming;
+
+typedef struct {
+	int points;                  // GPS points replayed
+	int traversals;              // Traversals detected by the replay
+	int expectedTraversals;      // Traversals in the committed file
+	int traversalMismatches;     // Lines that differ, including missing or extra lines
+	int firstTraversalMismatch;  // 1-based line of the first difference, 0 if none
+
+	int predictions;             // Minutes compared
+	int predictionMismatches;    // Exact-path minutes outside REGRESSION_PREDICTION_TOLERANCE
+	double maxPredictionError;
+	int tableMismatches;         // Kernel-table minutes outside the table tolerance
+	double maxTableError;
+	double denseMeanError;       // Largest table vs exact route mean difference on the dense sampling
+	double denseStdError;        // Same for the route std dev
+
+	StageTiming stages[REGRESSION_STAGES];
+	int slowStages;
+	int missingBaselines;
+	int recordedBaselines;
+
+	int passed;
+} RegressionReport;
+
+int runRegressionCheck(Segment* segments, int numSegments, int recordBaseline, RegressionReport* report);
+void printRegressionReport(RegressionReport* report, FILE* output);
+
+#endif // regression_check_h
@@ -0,0 +1,25 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "regression_check.h"
+#include "route_segments.h"
+
+#include <string.h>
+
+// Standalone regression check for builds and CI: "regression_main [--record]", run from the directory
+// holding gpsdata.txt and the committed outputs. --record stores this run's stage timings as the baseline
+// for this build in regression_baseline.txt. Built from the host sources without main.cpp and the
+// ESP32 firmware, so it needs no console interaction or file dialogs. Exit code 0 if every check passes.
+int main(int argc, char** argv) {
+	int recordBaseline = (argc > 1 && strcmp(argv[1], "--record") == 0);
+	if (argc > 2 || (argc > 1 && !recordBaseline)) {
+		printf("Usage: %s [--record]\n", argv[0]);
+		return 1;
+	}
+
+	printf("Running regression check (%d timed runs per stage)...\n", REGRESSION_TIMING_RUNS);
+
+	RegressionReport report;
+	int result = runRegressionCheck(routeSegments, NUM_SEGMENTS, recordBaseline, &report);
+	if (result >= 0) printRegressionReport(&report, stdout);
+	return (result == 0) ? 0 : 1;
+}
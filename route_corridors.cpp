@@ -0,0 +1,376 @@
+#include "route_corridors.h"
+#include "prediction.h"
+
+#include <math.h>
+#include <string.h>
+
+// Route centrelines, taken from the 2025-10-20 drive in gpsdata.txt. Each corridor runs from the
+// drive's entry into one segment box to its entry into the next (the last one to the box exit),
+// simplified with Douglas-Peucker at 4 m.
+Corridor routeCorridors[NUM_ROUTE_CORRIDORS] = {
+	// 1. 13th & Marine > Taylor Way
+	{ 1, CORRIDOR_DEFAULT_WIDTH, 6, {
+		{ 49.326591, -123.142178 }, { 49.326669, -123.141782 }, { 49.326719, -123.140770 }, { 49.326908, -123.135159 },
+		{ 49.327072, -123.135191 }, { 49.327069, -123.133338 } } },
+
+	// 2. Taylor Way > Lions Gate Bridge
+	{ 2, CORRIDOR_DEFAULT_WIDTH, 8, {
+		{ 49.327069, -123.133338 }, { 49.326391, -123.130465 }, { 49.326160, -123.129951 }, { 49.325938, -123.129753 },
+		{ 49.325693, -123.129696 }, { 49.325436, -123.129772 }, { 49.324109, -123.130666 }, { 49.323627, -123.131099 } } },
+
+	// 3. Lions Gate Bridge
+	{ 3, CORRIDOR_DEFAULT_WIDTH, 2, {
+		{ 49.323627, -123.131099 }, { 49.311452, -123.142291 } } },
+
+	// 4. Causeway > Denman
+	{ 4, CORRIDOR_DEFAULT_WIDTH, 29, {
+		{ 49.311452, -123.142291 }, { 49.310878, -123.142693 }, { 49.309922, -123.143595 }, { 49.309455, -123.143906 },
+		{ 49.308488, -123.144480 }, { 49.307621, -123.144817 }, { 49.306531, -123.145148 }, { 49.304821, -123.145356 },
+		{ 49.304069, -123.145313 }, { 49.302951, -123.144976 }, { 49.302324, -123.144643 }, { 49.301895, -123.144304 },
+		{ 49.301169, -123.143620 }, { 49.300367, -123.142714 }, { 49.299233, -123.140900 }, { 49.298758, -123.139909 },
+		{ 49.298028, -123.138020 }, { 49.297705, -123.137440 }, { 49.297339, -123.136984 }, { 49.296828, -123.136592 },
+		{ 49.296409, -123.136416 }, { 49.296002, -123.136406 }, { 49.295100, -123.136935 }, { 49.294830, -123.136945 },
+		{ 49.294576, -123.136839 }, { 49.294144, -123.136334 }, { 49.292639, -123.134028 }, { 49.292550, -123.133943 },
+		{ 49.292399, -123.134029 } } },
+
+	// 5. Denman > Pacific
+	{ 5, CORRIDOR_DEFAULT_WIDTH, 6, {
+		{ 49.292399, -123.134029 }, { 49.292083, -123.134520 }, { 49.291589, -123.135044 }, { 49.291277, -123.135756 },
+		{ 49.287052, -123.142227 }, { 49.286666, -123.142388 } } },
+
+	// 6. Pacific > Burrard St Bridge
+	{ 6, CORRIDOR_DEFAULT_WIDTH, 19, {
+		{ 49.286666, -123.142388 }, { 49.284565, -123.142710 }, { 49.284273, -123.142618 }, { 49.283392, -123.142092 },
+		{ 49.282902, -123.141542 }, { 49.280289, -123.137574 }, { 49.279868, -123.136840 }, { 49.279771, -123.136968 },
+		{ 49.279677, -123.136679 }, { 49.279414, -123.136275 }, { 49.279066, -123.135858 }, { 49.278633, -123.135110 },
+		{ 49.278383, -123.134840 }, { 49.278480, -123.134883 }, { 49.278114, -123.134143 }, { 49.277442, -123.133274 },
+		{ 49.277229, -123.132872 }, { 49.277009, -123.132748 }, { 49.276356, -123.134426 } } },
+
+	// 7. Burrard Bridge
+	{ 7, CORRIDOR_DEFAULT_WIDTH, 4, {
+		{ 49.276356, -123.134426 }, { 49.273043, -123.144621 }, { 49.272450, -123.145383 }, { 49.272463, -123.146863 } } },
+
+	// 8. Cornwall
+	{ 8, CORRIDOR_DEFAULT_WIDTH, 4, {
+		{ 49.272463, -123.146863 }, { 49.272463, -123.149845 }, { 49.272655, -123.157102 }, { 49.272746, -123.163815 } } },
+
+	// 9. Macdonald > W 4th
+	{ 9, CORRIDOR_DEFAULT_WIDTH, 7, {
+		{ 49.272746, -123.163815 }, { 49.272760, -123.164728 }, { 49.272704, -123.165059 }, { 49.271483, -123.168091 },
+		{ 49.271308, -123.168266 }, { 49.268408, -123.168388 }, { 49.268407, -123.169933 } } },
+
+	// 10. W 4th > Blanca
+	{ 10, CORRIDOR_DEFAULT_WIDTH, 9, {
+		{ 49.268407, -123.169933 }, { 49.268842, -123.199277 }, { 49.268748, -123.199893 }, { 49.268249, -123.201576 },
+		{ 49.268225, -123.202779 }, { 49.268303, -123.203333 }, { 49.268909, -123.205844 }, { 49.268977, -123.206320 },
+		{ 49.269149, -123.217124 } } },
+
+	// 11. Chancellor Blvd
+	{ 11, CORRIDOR_DEFAULT_WIDTH, 15, {
+		{ 49.269149, -123.217124 }, { 49.269047, -123.219025 }, { 49.268637, -123.223049 }, { 49.268615, -123.223692 },
+		{ 49.268670, -123.224339 }, { 49.268917, -123.225285 }, { 49.270613, -123.228890 }, { 49.271689, -123.231648 },
+		{ 49.272316, -123.233744 }, { 49.272762, -123.235635 }, { 49.273265, -123.238820 }, { 49.273569, -123.242352 },
+		{ 49.273579, -123.245193 }, { 49.273473, -123.247315 }, { 49.273367, -123.248149 } } },
+
+	// 12. Chancellor Roundabout → Fraser Parkade
+	{ 12, CORRIDOR_DEFAULT_WIDTH, 12, {
+		{ 49.273367, -123.248149 }, { 49.273241, -123.248570 }, { 49.272886, -123.250509 }, { 49.272489, -123.251660 },
+		{ 49.272025, -123.252753 }, { 49.271433, -123.253862 }, { 49.270789, -123.254791 }, { 49.269553, -123.257293 },
+		{ 49.268737, -123.258770 }, { 49.268656, -123.258819 }, { 49.268486, -123.258742 }, { 49.267337, -123.257761 } } },
+};
+
+static void toMetres(CorridorMatcher* matcher, double latUnits, double lonUnits, double* x, double* y) {
+	*x = (lonUnits - matcher->originLon) * matcher->metresPerLonUnit;
+	*y = (latUnits - matcher->originLat) * matcher->metresPerLatUnit;
+}
+
+// Range of grid cells overlapped by a box in metres, clamped to the grid
+static void cellRange(CorridorMatcher* matcher, double minX, double minY, double maxX, double maxY, int* cx0, int* cy0, int* cx1, int* cy1) {
+	*cx0 = (int)floor(minX / CORRIDOR_GRID_CELL);
+	*cy0 = (int)floor(minY / CORRIDOR_GRID_CELL);
+	*cx1 = (int)floor(maxX / CORRIDOR_GRID_CELL);
+	*cy1 = (int)floor(maxY / CORRIDOR_GRID_CELL);
+	if (*cx0 < 0) *cx0 = 0;
+	if (*cy0 < 0) *cy0 = 0;
+	if (*cx1 >= matcher->gridWidth) *cx1 = matcher->gridWidth - 1;
+	if (*cy1 >= matcher->gridHeight) *cy1 = matcher->gridHeight - 1;
+}
+
+// Build the piece list and matching grid for a set of corridors. Returns NULL on failure.
+CorridorMatcher* createCorridorMatcher(Corridor* corridors, int numCorridors) {
+	CorridorMatcher* matcher = (CorridorMatcher*)calloc(1, sizeof(CorridorMatcher));
+	if (matcher == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		return NULL;
+	}
+
+	matcher->corridors = corridors;
+	matcher->numCorridors = numCorridors;
+
+	// Projection centred on the route's bounding box, padded by the widest corridor so every
+	// point that can match lies inside the grid
+	double minLat = 90.0, maxLat = -90.0, minLon = 180.0, maxLon = -180.0, maxHalfWidth = 0.0;
+	int pieceCount = 0;
+	for (int c = 0; c < numCorridors; c++) {
+		for (int v = 0; v < corridors[c].vertexCount; v++) {
+			if (corridors[c].vertices[v].lat < minLat) minLat = corridors[c].vertices[v].lat;
+			if (corridors[c].vertices[v].lat > maxLat) maxLat = corridors[c].vertices[v].lat;
+			if (corridors[c].vertices[v].lon < minLon) minLon = corridors[c].vertices[v].lon;
+			if (corridors[c].vertices[v].lon > maxLon) maxLon = corridors[c].vertices[v].lon;
+		}
+		if (corridors[c].width / 2.0 > maxHalfWidth) maxHalfWidth = corridors[c].width / 2.0;
+		if (corridors[c].vertexCount > 1) pieceCount += corridors[c].vertexCount - 1;
+	}
+
+	double centreLat = (minLat + maxLat) / 2.0;
+	matcher->metresPerLatUnit = METRES_PER_DEGREE_LAT / COORD_SCALE;
+	matcher->metresPerLonUnit = METRES_PER_DEGREE_LON_EQUATOR * cos(centreLat * PI / 180.0) / COORD_SCALE;
+	matcher->originLat = minLat * COORD_SCALE - (maxHalfWidth + CORRIDOR_GRID_CELL) / matcher->metresPerLatUnit;
+	matcher->originLon = minLon * COORD_SCALE - (maxHalfWidth + CORRIDOR_GRID_CELL) / matcher->metresPerLonUnit;
+
+	double extentX, extentY;
+	toMetres(matcher, maxLat * COORD_SCALE, maxLon * COORD_SCALE, &extentX, &extentY);
+	matcher->gridWidth = (int)((extentX + maxHalfWidth) / CORRIDOR_GRID_CELL) + 2;
+	matcher->gridHeight = (int)((extentY + maxHalfWidth) / CORRIDOR_GRID_CELL) + 2;
+
+	int cellCount = matcher->gridWidth * matcher->gridHeight;
+	matcher->corridorLengths = (double*)calloc(numCorridors > 0 ? numCorridors : 1, sizeof(double));
+	matcher->pieces = (CorridorPiece*)malloc((pieceCount > 0 ? pieceCount : 1) * sizeof(CorridorPiece));
+	matcher->cellStart = (int*)calloc(cellCount + 1, sizeof(int));
+
+	if (!matcher->corridorLengths || !matcher->pieces || !matcher->cellStart) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		freeCorridorMatcher(matcher);
+		return NULL;
+	}
+
+	// Pieces in metres, with their distance along the corridor
+	for (int c = 0; c < numCorridors; c++) {
+		double along = 0.0;
+		for (int v = 0; v + 1 < corridors[c].vertexCount; v++) {
+			CorridorPiece* piece = &matcher->pieces[matcher->pieceCount++];
+			double x1, y1;
+			toMetres(matcher, corridors[c].vertices[v].lat * COORD_SCALE, corridors[c].vertices[v].lon * COORD_SCALE, &piece->x0, &piece->y0);
+			toMetres(matcher, corridors[c].vertices[v + 1].lat * COORD_SCALE, corridors[c].vertices[v + 1].lon * COORD_SCALE, &x1, &y1);
+			piece->dx = x1 - piece->x0;
+			piece->dy = y1 - piece->y0;
+			piece->lengthSquared = piece->dx * piece->dx + piece->dy * piece->dy;
+			piece->length = sqrt(piece->lengthSquared);
+			piece->startDistance = along;
+			piece->halfWidth = corridors[c].width / 2.0;
+			piece->corridor = c;
+			along += piece->length;
+		}
+		matcher->corridorLengths[c] = along;
+	}
+
+	// Bucket the pieces into every cell their corridor band overlaps (counting pass, then fill)
+	for (int pass = 0; pass < 2; pass++) {
+		for (int p = 0; p < matcher->pieceCount; p++) {
+			CorridorPiece* piece = &matcher->pieces[p];
+			int cx0, cy0, cx1, cy1;
+			cellRange(matcher,
+				fmin(piece->x0, piece->x0 + piece->dx) - piece->halfWidth, fmin(piece->y0, piece->y0 + piece->dy) - piece->halfWidth,
+				fmax(piece->x0, piece->x0 + piece->dx) + piece->halfWidth, fmax(piece->y0, piece->y0 + piece->dy) + piece->halfWidth,
+				&cx0, &cy0, &cx1, &cy1);
+
+			for (int cy = cy0; cy <= cy1; cy++) {
+				for (int cx = cx0; cx <= cx1; cx++) {
+					int cell = cy * matcher->gridWidth + cx;
+					if (pass == 0) matcher->cellStart[cell + 1]++;
+					else matcher->cellPieces[matcher->cellStart[cell]++] = p;
+				}
+			}
+		}
+
+		if (pass == 0) {
+			for (int cell = 0; cell < cellCount; cell++) matcher->cellStart[cell + 1] += matcher->cellStart[cell];
+			matcher->cellPieces = (int*)malloc((matcher->cellStart[cellCount] > 0 ? matcher->cellStart[cellCount] : 1) * sizeof(int));
+			if (matcher->cellPieces == NULL) {
+				fprintf(stderr, "Memory allocation failed.\n");
+				freeCorridorMatcher(matcher);
+				return NULL;
+			}
+		}
+	}
+	// The fill pass advanced each cellStart to the next cell's start, shift them back
+	for (int cell = cellCount; cell > 0; cell--) matcher->cellStart[cell] = matcher->cellStart[cell - 1];
+	matcher->cellStart[0] = 0;
+
+	return matcher;
+}
+
+void freeCorridorMatcher(CorridorMatcher* matcher) {
+	if (matcher == NULL) return;
+	free(matcher->corridorLengths);
+	free(matcher->pieces);
+	free(matcher->cellStart);
+	free(matcher->cellPieces);
+	free(matcher);
+}
+
+// Index of the corridor whose centreline is nearest to the point, among those whose band contains it,
+// or -1 if the point is off the route. alongDistance receives the position along that corridor.
+// The preferred corridor (the one currently being driven, or -1) wins while its band contains the point
+// and the point is short of its far end, so jitter where two corridors meet cannot flip the match back
+// and forth, and a handover to the next corridor only happens near the end of the current one.
+int matchPointToCorridor(CorridorMatcher* matcher, ESPDataPoint* point, int preferred, double* alongDistance) {
+	double x, y;
+	toMetres(matcher, (double)point->lat, (double)point->lon, &x, &y);
+
+	int cx = (int)floor(x / CORRIDOR_GRID_CELL);
+	int cy = (int)floor(y / CORRIDOR_GRID_CELL);
+	if (cx < 0 || cy < 0 || cx >= matcher->gridWidth || cy >= matcher->gridHeight) return -1;
+
+	int cell = cy * matcher->gridWidth + cx;
+	int best = -1;
+	double bestDistanceSquared = 0.0;
+	double bestAlong = 0.0;
+	double preferredDistanceSquared = -1.0;
+	double preferredAlong = 0.0;
+
+	for (int k = matcher->cellStart[cell]; k < matcher->cellStart[cell + 1]; k++) {
+		CorridorPiece* piece = &matcher->pieces[matcher->cellPieces[k]];
+
+		double t = (piece->lengthSquared > 0.0) ? ((x - piece->x0) * piece->dx + (y - piece->y0) * piece->dy) / piece->lengthSquared : 0.0;
+		if (t < 0.0) t = 0.0;
+		if (t > 1.0) t = 1.0;
+
+		double ex = x - (piece->x0 + t * piece->dx);
+		double ey = y - (piece->y0 + t * piece->dy);
+		double distanceSquared = ex * ex + ey * ey;
+
+		if (distanceSquared > piece->halfWidth * piece->halfWidth) continue;
+
+		double along = piece->startDistance + t * piece->length;
+		if (best < 0 || distanceSquared < bestDistanceSquared) {
+			best = piece->corridor;
+			bestDistanceSquared = distanceSquared;
+			bestAlong = along;
+		}
+		if (piece->corridor == preferred && (preferredDistanceSquared < 0.0 || distanceSquared < preferredDistanceSquared)) {
+			preferredDistanceSquared = distanceSquared;
+			preferredAlong = along;
+		}
+	}
+
+	if (preferredDistanceSquared >= 0.0 && preferredAlong < matcher->corridorLengths[preferred] - CORRIDOR_END_TOLERANCE) {
+		best = preferred;
+		bestAlong = preferredAlong;
+	}
+	if (best >= 0 && alongDistance) *alongDistance = bestAlong;
+	return best;
+}
+
+// A visit to one corridor: consecutive points matched to it, allowing short off-route gaps
+typedef struct {
+	int corridor;      // -1 when no visit is in progress
+	int startIndex;
+	int lastIndex;     // Last point matched to the corridor
+	double minAlong;
+	double maxAlong;
+	int fromRoute;     // Entered straight from an adjacent corridor rather than from off the route
+	SpeedStats speed;  // Over startIndex .. lastIndex, including bridged off-route points
+} CorridorRun;
+
+// Close a visit. Visits that cover the corridor end to end are recorded like box traversals,
+// returns 0 for a partial visit. An end counts as covered when the visit reached near it, or when
+// the points on that side matched the neighbouring corridor (at speed, the first or last point in
+// a corridor can be well inside it). A jump to a corridor that is not adjacent along the route
+// (GPS glitch, parallel road) does not cover the end.
+static int finishRun(CorridorMatcher* matcher, ESPDataPoint* data, CorridorRun* run, int toRoute, TraversalStore* traversals, CorridorStats* stats) {
+	double length = matcher->corridorLengths[run->corridor];
+	int coveredStart = run->fromRoute || run->minAlong <= CORRIDOR_END_TOLERANCE;
+	int coveredEnd = toRoute || run->maxAlong >= length - CORRIDOR_END_TOLERANCE;
+	if (!coveredStart || !coveredEnd) {
+		stats->partialRuns++;
+		return 0;
+	}
+
+	double duration = (double)(data[run->lastIndex].timestamp - data[run->startIndex].timestamp);
+	if (duration >= 10 && duration <= MAX_TRAVERSAL_DURATION) {
+		int segment_id = matcher->corridors[run->corridor].segment_id;
+		if (recordTraversal(traversals, segment_id, duration, &data[run->startIndex], &run->speed) == 0) {
+			if (getESPDataVerbose()) printf("Exited segment %d at index %d (duration: %.1f sec)\n", segment_id, run->lastIndex, duration);
+		}
+	}
+	return 1;
+}
+
+// Map-matched traversal detection. Every point is assigned to a corridor (or none); a traversal is a
+// visit that enters a corridor and covers it end to end. Leaving a corridor through its side for more
+// than CORRIDOR_GAP_SECONDS and rejoining the route later counts as a detour, and the partial visit
+// is dropped instead of being recorded with a distorted duration. Speed statistics are accumulated as
+// each visit grows, so the points are swept once. Returns the number of traversals added.
+int detectCorridorTraversals(CorridorMatcher* matcher, ESPDataPoint* data, int numPoints, TraversalStore* traversals, CorridorStats* stats) {
+	int initialCount = traversals->count;
+	memset(stats, 0, sizeof(CorridorStats));
+
+	CorridorRun run;
+	run.corridor = -1;
+	int detourCorridor = -1;    // Corridor left mid-way, until the route is rejoined
+	long long detourStart = 0;
+
+	for (int i = 0; i < numPoints; i++) {
+		double along = 0.0;
+		int c = matchPointToCorridor(matcher, &data[i], run.corridor, &along);
+		if (c >= 0) stats->matchedPoints++;
+		else stats->offRoutePoints++;
+
+		// A gap in the log ends whatever was in progress, like data ending inside a box
+		if (i > 0 && data[i].timestamp - data[i - 1].timestamp > CORRIDOR_GAP_SECONDS) {
+			run.corridor = -1;
+			detourCorridor = -1;
+		}
+
+		int handover = 0;
+		if (run.corridor >= 0 && c != run.corridor) {
+			// Short excursions outside the band are GPS noise
+			if (c < 0 && data[i].timestamp - data[run.lastIndex].timestamp <= CORRIDOR_GAP_SECONDS) continue;
+
+			// Corridors are in route order, so only the next or previous one is a handover
+			int adjacent = (c >= 0 && abs(c - run.corridor) == 1);
+			if (!finishRun(matcher, data, &run, adjacent, traversals, stats) && c < 0) {
+				detourCorridor = run.corridor;
+				detourStart = data[run.lastIndex].timestamp;
+			}
+			handover = adjacent;
+			run.corridor = -1;
+		}
+
+		if (c < 0) continue;
+
+		if (c == run.corridor) {
+			for (int k = run.lastIndex; k < i; k++) addSpeedInterval(&run.speed, &data[k], &data[k + 1]);
+			run.lastIndex = i;
+			if (along < run.minAlong) run.minAlong = along;
+			if (along > run.maxAlong) run.maxAlong = along;
+			continue;
+		}
+
+		if (detourCorridor >= 0) {
+			long long away = data[i].timestamp - detourStart;
+			if (away <= MAX_TRAVERSAL_DURATION) {
+				if (getESPDataVerbose()) {
+					int year, month, day, seconds;
+					pointLocalTime(&data[i], &year, &month, &day, &seconds);
+					printf("Detour: left segment %d, rejoined the route at segment %d after %lld sec (%04d-%02d-%02d %02d:%02d:%02d)\n",
+						matcher->corridors[detourCorridor].segment_id, matcher->corridors[c].segment_id, away,
+						year, month, day, seconds / 3600, (seconds % 3600) / 60, seconds % 60);
+				}
+				stats->detours++;
+			}
+			detourCorridor = -1;
+		}
+
+		run.fromRoute = handover;
+		run.corridor = c;
+		run.startIndex = i;
+		run.lastIndex = i;
+		run.minAlong = along;
+		run.maxAlong = along;
+		beginSpeedStats(&run.speed, &data[i]);
+	}
+
+	return traversals->count - initialCount;
+}
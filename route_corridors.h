@@ -0,0 +1,76 @@
+#ifndef ROUTE_CORRIDORS_H
+#define ROUTE_CORRIDORS_H
+
+#include "esp_data.h"
+
+#define NUM_ROUTE_CORRIDORS 12
+#define CORRIDOR_MAX_VERTICES 32
+#define CORRIDOR_DEFAULT_WIDTH 50.0   // Corridor width in metres, centred on the centreline
+#define CORRIDOR_GRID_CELL 100.0      // Matching grid cell size in metres
+#define CORRIDOR_GAP_SECONDS 15       // Off-route stretches shorter than this are GPS noise, not a departure from the corridor
+#define CORRIDOR_END_TOLERANCE 40.0   // A traversal must reach within this many metres of both corridor ends
+#define METRES_PER_DEGREE_LAT 111132.0
+#define METRES_PER_DEGREE_LON_EQUATOR 111320.0 // Scaled by cos(latitude) away from the equator
+
+typedef struct {
+	double lat;
+	double lon;
+} RoutePoint;
+
+// Segment geometry as a centreline polyline plus a width. Corridors of consecutive segments share
+// their end and start vertices, so the route is covered without gaps or overlapping boxes.
+typedef struct {
+	int segment_id;
+	double width;
+	int vertexCount;
+	RoutePoint vertices[CORRIDOR_MAX_VERTICES];
+} Corridor;
+
+// One straight piece of a centreline in the matcher's local metric frame
+typedef struct {
+	double x0, y0;         // Start of the piece in metres
+	double dx, dy;         // Piece vector in metres
+	double length;
+	double lengthSquared;
+	double startDistance;  // Distance along the corridor at the start of the piece
+	double halfWidth;
+	int corridor;          // Index into the corridor array
+} CorridorPiece;
+
+// Uniform grid over the route; each cell lists the pieces whose corridor overlaps it, so a point is
+// only compared against the few nearby pieces. Cell c lists cellPieces[cellStart[c] .. cellStart[c + 1]).
+typedef struct {
+	Corridor* corridors;
+	int numCorridors;
+	double* corridorLengths;  // Centreline length of each corridor in metres
+
+	CorridorPiece* pieces;
+	int pieceCount;
+
+	// Equirectangular projection from fixed-point coordinates to metres, relative to the grid origin
+	double originLat;
+	double originLon;
+	double metresPerLatUnit;
+	double metresPerLonUnit;
+
+	int gridWidth;
+	int gridHeight;
+	int* cellStart;
+	int* cellPieces;
+} CorridorMatcher;
+
+typedef struct {
+	int matchedPoints;  // Points inside some corridor
+	int offRoutePoints;
+	int partialRuns;    // Corridor visits that did not cover the corridor end to end
+	int detours;        // Departures from the route mid-corridor that later rejoined it
+} CorridorStats;
+
+extern Corridor routeCorridors[NUM_ROUTE_CORRIDORS];
+
+CorridorMatcher* createCorridorMatcher(Corridor* corridors, int numCorridors);
+void freeCorridorMatcher(CorridorMatcher* matcher);
+int matchPointToCorridor(CorridorMatcher* matcher, ESPDataPoint* point, int preferred, double* alongDistance);
+int detectCorridorTraversals(CorridorMatcher* matcher, ESPDataPoint* data, int numPoints, TraversalStore* traversals, CorridorStats* stats);
+
+#endif // route_corridors_h
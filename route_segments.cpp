@@ -0,0 +1,40 @@
+#include "route_segments.h"
+
+// Drive segment dictionary
+Segment routeSegments[NUM_SEGMENTS] = {
+	// 1. 13th & Marine > Taylor Way
+	{1, 49.3260, -123.1516, 49.3283, -123.1340},
+
+	// 2. Taylor Way > Lions Gate Bridge
+	{2, 49.3239, -123.1335, 49.3278, -123.1290},
+
+	// 3. Lions Gate Bridge
+	{3, 49.3117, -123.1429, 49.3238, -123.1308},
+
+	// 4. Causeway > Denman
+	{4, 49.2925, -123.1518, 49.3117, -123.1333},
+
+	// 5. Denman > Pacific
+	{5, 49.2868, -123.1425, 49.2924, -123.1332},
+
+	// 6. Pacific > Burrard St Bridge
+	{6, 49.2766, -123.1430, 49.2867, -123.1320},
+
+	// 7. Burrard Bridge
+	{7, 49.2720, -123.1465, 49.2764, -123.1326},
+
+	// 8. Cornwall
+	{8, 49.2721, -123.1634, 49.2732, -123.1468},
+
+	// 9. Macdonald > W 4th
+	{9, 49.2680, -123.1692, 49.2729, -123.1637},
+
+	// 10. W 4th > Blanca
+	{10, 49.2671, -123.2165, 49.2693, -123.1698},
+
+	// 11. Chancellor Blvd
+	{11, 49.2668, -123.2477, 49.2737, -123.2171},
+
+	// 12. Chancellor Roundabout → Fraser Parkade
+	{12, 49.2673, -123.2597, 49.2737, -123.2481}
+};
@@ -0,0 +1,11 @@
+#ifndef ROUTE_SEGMENTS_H
+#define ROUTE_SEGMENTS_H
+
+#include "esp_data.h"
+#include "prediction.h"
+
+// Bounding boxes of the route's segments in driving order, shared by the interactive program and
+// the standalone regression check
+extern Segment routeSegments[NUM_SEGMENTS];
+
+#endif // route_segments_h
@@ -0,0 +1,238 @@
+#include "trip_state.h"
+
+#include <math.h>
+#include <string.h>
+
+// Std dev used to standardize residuals and to scale the forecast shift (floored)
+static double residualScale(double mean, double stddev) {
+	if (stddev < TRIP_MIN_RELATIVE_STDDEV * mean) stddev = TRIP_MIN_RELATIVE_STDDEV * mean;
+	if (stddev < TRIP_MIN_STDDEV) stddev = TRIP_MIN_STDDEV;
+	return stddev;
+}
+
+// Standardized residual of a duration against the tables' baseline at its start time, clipped
+static double standardizedResidual(KernelTables* tables, int segmentIndex, int startTime, double duration) {
+	double mean, stddev;
+	lookupSegmentDuration(tables, segmentIndex, (double)startTime, &mean, &stddev);
+
+	double z = (duration - mean) / residualScale(mean, stddev);
+	if (z > TRIP_MAX_RESIDUAL) z = TRIP_MAX_RESIDUAL;
+	if (z < -TRIP_MAX_RESIDUAL) z = -TRIP_MAX_RESIDUAL;
+	return z;
+}
+
+// Leading eigenvector and eigenvalue of a small symmetric matrix by power iteration
+static double leadingEigenvector(double matrix[NUM_SEGMENTS][NUM_SEGMENTS], int n, double* vector) {
+	double eigenvalue = 0.0;
+	for (int i = 0; i < n; i++) vector[i] = 1.0 / sqrt((double)n);
+
+	for (int iteration = 0; iteration < 100; iteration++) {
+		double next[NUM_SEGMENTS];
+		double norm = 0.0;
+		for (int i = 0; i < n; i++) {
+			next[i] = 0.0;
+			for (int j = 0; j < n; j++) next[i] += matrix[i][j] * vector[j];
+			norm += next[i] * next[i];
+		}
+		norm = sqrt(norm);
+		if (norm == 0.0) return 0.0;
+
+		eigenvalue = 0.0;
+		for (int i = 0; i < n; i++) {
+			eigenvalue += vector[i] * next[i]; // Rayleigh quotient with the previous (unit) vector
+			vector[i] = next[i] / norm;
+		}
+	}
+	return eigenvalue;
+}
+
+// Learn the one-factor model from the history. Drives are runs of traversals on the same day through
+// consecutive segments (as in the backtest). Each traversal is standardized against the tables'
+// baseline, pairwise correlations are taken over the drives covering both segments and shrunk towards
+// zero, and the loadings are fitted to them by iterated principal factoring. Returns -1 on failure.
+int learnSegmentCorrelations(Segment* segments, int numSegments, TraversalStore* traversals, KernelTables* tables, SegmentCorrelations* correlations) {
+	int n = (numSegments < NUM_SEGMENTS) ? numSegments : NUM_SEGMENTS;
+	memset(correlations, 0, sizeof(SegmentCorrelations));
+	correlations->numSegments = n;
+
+	int traversalCount = traversals->count;
+	TraversalFeatures* features = (TraversalFeatures*)malloc((traversalCount > 0 ? traversalCount : 1) * sizeof(TraversalFeatures));
+	if (features == NULL) {
+		fprintf(stderr, "Memory allocation failed.\n");
+		return -1;
+	}
+	computeTraversalFeatures(segments, n, traversals, features);
+
+	// Pairwise sums over drives: count, sum z_i, sum z_i^2 and sum z_i z_j ([i][j] seen from row i)
+	double sumZ[NUM_SEGMENTS][NUM_SEGMENTS] = { { 0 } };
+	double sumZZ[NUM_SEGMENTS][NUM_SEGMENTS] = { { 0 } };
+	double sumCross[NUM_SEGMENTS][NUM_SEGMENTS] = { { 0 } };
+
+	int i = 0;
+	while (i < traversalCount) {
+		if (features[i].segmentIndex < 0) {
+			i++;
+			continue;
+		}
+
+		// Standardized residuals of one drive, indexed by segment
+		double z[NUM_SEGMENTS];
+		int present[NUM_SEGMENTS] = { 0 };
+		int length = 0;
+
+		int first = i;
+		while (1) {
+			int s = features[i].segmentIndex;
+			z[s] = standardizedResidual(tables, s, features[i].startTime, (double)features[i].duration);
+			present[s] = 1;
+			length++;
+
+			if (i + 1 < traversalCount &&
+				features[i + 1].dayIndex == features[first].dayIndex &&
+				features[i + 1].segmentIndex == s + 1 &&
+				features[i + 1].startTime >= features[i].startTime) {
+				i++;
+			}
+			else {
+				break;
+			}
+		}
+		i++;
+
+		if (length < 2) continue;
+		correlations->drives++;
+
+		for (int a = 0; a < n; a++) {
+			if (!present[a]) continue;
+			for (int b = 0; b < n; b++) {
+				if (!present[b] || a == b) continue;
+				correlations->pairCounts[a][b]++;
+				sumZ[a][b] += z[a];
+				sumZZ[a][b] += z[a] * z[a];
+				sumCross[a][b] += z[a] * z[b];
+			}
+		}
+	}
+	free(features);
+
+	// Shrunk Pearson correlations; fewer than 3 shared drives carry no usable information
+	for (int a = 0; a < n; a++) {
+		for (int b = 0; b < n; b++) {
+			int count = correlations->pairCounts[a][b];
+			if (a == b || count < 3) continue;
+
+			double meanA = sumZ[a][b] / count, meanB = sumZ[b][a] / count;
+			double varA = sumZZ[a][b] / count - meanA * meanA;
+			double varB = sumZZ[b][a] / count - meanB * meanB;
+			double covariance = sumCross[a][b] / count - meanA * meanB;
+			if (varA <= 0.0 || varB <= 0.0) continue;
+
+			double r = covariance / sqrt(varA * varB);
+			if (r > 1.0) r = 1.0;
+			if (r < -1.0) r = -1.0;
+			correlations->correlation[a][b] = r * count / (count + TRIP_SHRINKAGE_RUNS);
+		}
+	}
+
+	// Iterated principal factor: put the current communalities (loading^2) on the diagonal and take
+	// the leading eigenvector as the new loadings. Starts from the largest correlation of each segment.
+	double reduced[NUM_SEGMENTS][NUM_SEGMENTS];
+	memcpy(reduced, correlations->correlation, sizeof(reduced));
+	for (int a = 0; a < n; a++) {
+		double largest = 0.0;
+		for (int b = 0; b < n; b++) {
+			if (fabs(correlations->correlation[a][b]) > largest) largest = fabs(correlations->correlation[a][b]);
+		}
+		reduced[a][a] = largest;
+	}
+
+	for (int iteration = 0; iteration < TRIP_FACTOR_ITERATIONS; iteration++) {
+		double vector[NUM_SEGMENTS];
+		double eigenvalue = leadingEigenvector(reduced, n, vector);
+		double scale = (eigenvalue > 0.0) ? sqrt(eigenvalue) : 0.0;
+
+		double sum = 0.0;
+		for (int a = 0; a < n; a++) sum += vector[a];
+		if (sum < 0.0) scale = -scale; // Orient the factor so that positive means slower than usual
+
+		for (int a = 0; a < n; a++) {
+			double loading = vector[a] * scale;
+			if (loading > TRIP_MAX_LOADING) loading = TRIP_MAX_LOADING;
+			if (loading < -TRIP_MAX_LOADING) loading = -TRIP_MAX_LOADING;
+			correlations->loading[a] = loading;
+			reduced[a][a] = loading * loading;
+		}
+	}
+	return 0;
+}
+
+void startTrip(TripState* trip, SegmentCorrelations* correlations, KernelTables* tables, int startSegment, int departureTime) {
+	trip->correlations = correlations;
+	trip->tables = tables;
+	trip->nextSegment = startSegment;
+	trip->currentTime = departureTime;
+	trip->elapsed = 0.0;
+	trip->factorPrecision = 1.0; // Standard normal prior on the factor
+	trip->factorInformation = 0.0;
+}
+
+// Fold the segment just driven into the factor posterior (conjugate Gaussian update) and move on
+// to the next segment. O(1).
+void tripSegmentCompleted(TripState* trip, int startTime, double duration) {
+	if (trip->nextSegment >= trip->tables->numSegments) return;
+
+	int s = trip->nextSegment;
+	double loading = trip->correlations->loading[s];
+	double noiseVariance = 1.0 - loading * loading;
+	double z = standardizedResidual(trip->tables, s, startTime, duration);
+
+	trip->factorPrecision += loading * loading / noiseVariance;
+	trip->factorInformation += loading * z / noiseVariance;
+
+	trip->nextSegment++;
+	trip->currentTime = fmod(startTime + duration, 86400.0);
+	trip->elapsed += duration;
+}
+
+// Forecast the remaining segments, each at its expected arrival time. With correlations the
+// baseline of each segment is shifted by loading * scale * factor mean, where scale is the floored
+// std dev the residuals were standardized with, and the shared factor uncertainty adds coherently
+// across segments instead of averaging out. Without them this is the
+// independent-segment forecast of predictOverallDurationTabulated. O(remaining segments).
+void forecastTrip(TripState* trip, int useCorrelations, TripForecast* forecast) {
+	double factorMean = useCorrelations ? trip->factorInformation / trip->factorPrecision : 0.0;
+	double factorVariance = useCorrelations ? 1.0 / trip->factorPrecision : 0.0;
+
+	double currentTime = trip->currentTime;
+	double noiseVariance = 0.0; // Independent part of the remaining variance
+	double factorScale = 0.0;   // Sum of loading * scale, the remaining route's exposure to the factor
+
+	memset(forecast->segmentMeans, 0, sizeof(forecast->segmentMeans));
+	forecast->factorMean = factorMean;
+	forecast->remainingMean = 0.0;
+
+	for (int s = trip->nextSegment; s < trip->tables->numSegments; s++) {
+		double mean, stddev;
+		lookupSegmentDuration(trip->tables, s, (double)(int)currentTime, &mean, &stddev);
+
+		double loading = useCorrelations ? trip->correlations->loading[s] : 0.0;
+		double exposure = loading * residualScale(mean, stddev);
+		double segmentMean = mean + exposure * factorMean;
+		if (segmentMean < 0.0) segmentMean = 0.0;
+
+		forecast->segmentMeans[s] = segmentMean;
+		forecast->remainingMean += segmentMean;
+		// Independent part: what the factor does not explain of the baseline variance
+		double segmentNoise = stddev * stddev - exposure * exposure;
+		noiseVariance += (segmentNoise > 0.0) ? segmentNoise : 0.0;
+		factorScale += exposure;
+
+		currentTime += segmentMean;
+		if (currentTime >= 86400) {
+			currentTime -= 86400; // Wrap around midnight
+		}
+	}
+
+	forecast->remainingStddev = sqrt(noiseVariance + factorScale * factorScale * factorVariance);
+	forecast->arrivalTime = fmod(trip->currentTime + forecast->remainingMean, 86400.0);
+}
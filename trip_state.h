@@ -0,0 +1,52 @@
+#ifndef TRIP_STATE_H
+#define TRIP_STATE_H
+
+#include "esp_data.h"
+#include "kernel_tables.h"
+#include "prediction.h"
+
+#define TRIP_SHRINKAGE_RUNS 10.0 // Pairwise correlations from n drives are shrunk towards 0 by n / (n + this)
+#define TRIP_MAX_LOADING 0.9     // Cap on a segment's factor loading, keeps every segment some independent noise
+#define TRIP_MIN_STDDEV 1.0      // Floor on the baseline std dev when standardizing durations
+#define TRIP_MIN_RELATIVE_STDDEV 0.1 // ... and as a fraction of the baseline mean, for segments with few similar traversals
+#define TRIP_MAX_RESIDUAL 3.0    // Standardized residuals are clipped to +/- this, so one freak segment cannot dominate the factor
+#define TRIP_FACTOR_ITERATIONS 10
+
+// One-factor model of how segment durations on the same drive move together. The standardized
+// residual of segment s against the kernel-table baseline is z_s = loading_s * F + e_s, where F is
+// a per-drive "traffic today" factor shared by all segments and e_s is independent noise with
+// variance 1 - loading_s^2, so corr(z_i, z_j) = loading_i * loading_j.
+typedef struct {
+	int numSegments;
+	double loading[NUM_SEGMENTS];
+	int drives;                          // Same-day drives the correlations were learned from
+	int pairCounts[NUM_SEGMENTS][NUM_SEGMENTS];
+	double correlation[NUM_SEGMENTS][NUM_SEGMENTS]; // Shrunk pairwise correlations the loadings were fitted to
+} SegmentCorrelations;
+
+// Live state of one drive. Each completed segment updates the posterior of the drive's factor in
+// O(1); a forecast of the remaining segments is O(remaining segments).
+typedef struct {
+	SegmentCorrelations* correlations;
+	KernelTables* tables;     // Baseline per-segment mean and std dev for the trip's date
+	int nextSegment;          // Index of the segment being driven
+	double currentTime;       // Seconds after midnight at the start of nextSegment
+	double elapsed;           // Observed duration so far
+	double factorPrecision;   // Posterior precision of the factor, 1 + sum(loading^2 / noise variance)
+	double factorInformation; // sum(loading * z / noise variance); posterior mean is this / precision
+} TripState;
+
+typedef struct {
+	double factorMean;        // Posterior mean of the drive's factor (0 before any segment completes)
+	double remainingMean;     // Remaining route duration
+	double remainingStddev;
+	double arrivalTime;       // Expected arrival, seconds after midnight
+	double segmentMeans[NUM_SEGMENTS]; // Forecast per remaining segment (earlier entries are 0)
+} TripForecast;
+
+int learnSegmentCorrelations(Segment* segments, int numSegments, TraversalStore* traversals, KernelTables* tables, SegmentCorrelations* correlations);
+void startTrip(TripState* trip, SegmentCorrelations* correlations, KernelTables* tables, int startSegment, int departureTime);
+void tripSegmentCompleted(TripState* trip, int startTime, double duration);
+void forecastTrip(TripState* trip, int useCorrelations, TripForecast* forecast);
+
+#endif // trip_state_h
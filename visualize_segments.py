@@ -1,42 +1,84 @@
+import os
 import folium
 import pandas as pd
 from datetime import datetime
 
-# Load GPS data safely
-data = pd.read_csv(
-    "gpsdata.txt",
-    header=None,
-    names=["lat", "lon", "speed", "year", "month", "day", "time"],
-    dtype=str,
-    on_bad_lines="skip"
-)
-
-# Filter valid rows
-data = data[pd.to_numeric(data["lat"], errors="coerce").notnull()]
-data["lat"] = data["lat"].astype(float)
-data["lon"] = data["lon"].astype(float)
-
-# Combine date and time into datetime object for gap detection
-def parse_time(row):
-    try:
-        return datetime.strptime(f"{row['year']}-{row['month']}-{row['day']} {row['time']}", "%Y-%m-%d %H:%M:%S")
-    except Exception:
-        return None
-
-data["datetime"] = data.apply(parse_time, axis=1)
-data = data.dropna(subset=["datetime"]).sort_values("datetime").reset_index(drop=True)
-
-# Split GPS data into drives if gap > 5 minutes
-drives = []
-current_drive = [data.iloc[0]]
-for i in range(1, len(data)):
-    delta = (data["datetime"][i] - data["datetime"][i - 1]).total_seconds()
-    if delta > 300:  # 5 minutes gap → new drive
+# Pre-aggregated tables written by the C++ export (menu option "Export dashboard tables").
+# Their size does not depend on how much history has been collected; without them the
+# script falls back to drawing every drive in the raw GPS log.
+HEATMAP_FILE = "segment_heatmap.csv"
+ROUTE_POLYLINE_FILE = "route_polyline.csv"
+
+# Load GPS data safely and split it into drives
+def load_raw_drives():
+    data = pd.read_csv(
+        "gpsdata.txt",
+        header=None,
+        names=["lat", "lon", "speed", "year", "month", "day", "time"],
+        dtype=str,
+        on_bad_lines="skip"
+    )
+
+    # Filter valid rows
+    data = data[pd.to_numeric(data["lat"], errors="coerce").notnull()]
+    data["lat"] = data["lat"].astype(float)
+    data["lon"] = data["lon"].astype(float)
+
+    # Combine date and time into datetime object for gap detection
+    def parse_time(row):
+        try:
+            return datetime.strptime(f"{row['year']}-{row['month']}-{row['day']} {row['time']}", "%Y-%m-%d %H:%M:%S")
+        except Exception:
+            return None
+
+    data["datetime"] = data.apply(parse_time, axis=1)
+    data = data.dropna(subset=["datetime"]).sort_values("datetime").reset_index(drop=True)
+
+    # Split GPS data into drives if gap > 5 minutes
+    drives = []
+    current_drive = [data.iloc[0]]
+    for i in range(1, len(data)):
+        delta = (data["datetime"][i] - data["datetime"][i - 1]).total_seconds()
+        if delta > 300:  # 5 minutes gap → new drive
+            drives.append(current_drive)
+            current_drive = []
+        current_drive.append(data.iloc[i])
+    if current_drive:
         drives.append(current_drive)
-        current_drive = []
-    current_drive.append(data.iloc[i])
-if current_drive:
-    drives.append(current_drive)
+    return drives
+
+# Weekday x hour table of median durations for one segment, as HTML for the segment popup.
+# Only hours with data are shown; cells are shaded from green (fastest) to red (slowest).
+DAY_NAMES = ["Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"]
+
+def heatmap_table(heatmap, segment_id):
+    cells = heatmap[(heatmap["segment_id"] == segment_id) & (heatmap["count"] > 0)]
+    if cells.empty:
+        return "<i>No traversals</i>"
+
+    hours = sorted((cells["hour_of_week"] % 24).unique())
+    fastest, slowest = cells["p50"].min(), cells["p50"].max()
+    by_hour = {int(row.hour_of_week): row for row in cells.itertuples()}
+
+    html = "<table style='border-collapse:collapse;font-size:11px'><tr><th></th>"
+    html += "".join(f"<th>{h:02d}h</th>" for h in hours) + "</tr>"
+    for day, name in enumerate(DAY_NAMES):
+        html += f"<tr><th>{name}</th>"
+        for h in hours:
+            row = by_hour.get(day * 24 + h)
+            if row is None:
+                html += "<td></td>"
+                continue
+            level = 0.0 if slowest == fastest else (row.p50 - fastest) / (slowest - fastest)
+            colour = f"rgb({int(255 * level)},{int(200 * (1 - level))},80)"
+            html += (f"<td style='background:{colour};padding:2px' title='p90 {row.p90:.0f}s, n={row.count}'>"
+                     f"{row.p50:.0f}</td>")
+        html += "</tr>"
+    return html + "</table><small>median seconds, hover for p90 and count</small>"
+
+heatmap = pd.read_csv(HEATMAP_FILE) if os.path.exists(HEATMAP_FILE) else None
+route = pd.read_csv(ROUTE_POLYLINE_FILE) if os.path.exists(ROUTE_POLYLINE_FILE) else None
+drives = load_raw_drives() if route is None else []
 
 # Define segments
 segments = [
@@ -68,23 +110,32 @@ colors = [
 # Create map centered on route
 m = folium.Map(location=[49.28, -123.16], zoom_start=12, tiles="OpenStreetMap")
 
-# Add segments with hover titles
+# Add segments with hover titles, and the duration heatmap in the popup when it has been exported
 for i, s in enumerate(segments):
     color = colors[i % len(colors)]
+    popup = f"Segment {s['id']}: {s['name']}"
+    if heatmap is not None:
+        popup = folium.Popup(f"<b>{popup}</b><br>{heatmap_table(heatmap, s['id'])}", max_width=600)
     folium.Rectangle(
         bounds=[(s["min_lat"], s["min_lon"]), (s["max_lat"], s["max_lon"])],
         color=color,
         fill=True,
         fill_opacity=0.25,
         fill_color=color,
-        popup=f"Segment {s['id']}: {s['name']}",
+        popup=popup,
         tooltip=f"Segment {s['id']}: {s['name']}"
     ).add_to(m)
 
-# Add each drive separately to avoid long jumps
-for drive in drives:
-    points = [(p["lat"], p["lon"]) for _, p in pd.DataFrame(drive).iterrows()]
-    folium.PolyLine(points, color="black", weight=2.5, opacity=0.9).add_to(m)
+if route is not None:
+    # Exported route centreline, one polyline per segment
+    for segment_id, points in route.groupby("segment_id", sort=False):
+        folium.PolyLine(list(zip(points["lat"], points["lon"])), color="black", weight=2.5, opacity=0.9,
+                        tooltip=f"Segment {segment_id}").add_to(m)
+else:
+    # Add each drive separately to avoid long jumps
+    for drive in drives:
+        points = [(p["lat"], p["lon"]) for _, p in pd.DataFrame(drive).iterrows()]
+        folium.PolyLine(points, color="black", weight=2.5, opacity=0.9).add_to(m)
 
 # Save map
 m.save("segments_map.html")